@@ -0,0 +1,192 @@
+#include "autotuner.h"
+#include "primerunnable.h"
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QSysInfo>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+// Zakres prób: 2^20 liczb od 10^9, czyli kilkadziesiąt tysięcy liczb pierwszych
+const quint64 kTrialStart = 1000000000;
+const quint64 kTrialNumbers = 1 << 20;
+
+// Każda konfiguracja jest mierzona kilka razy, liczy się najlepszy wynik
+const int kTrialRepeats = 2;
+
+const int kPiecesPerThreadCandidates[] = {1, 2, 4, 8};
+
+const char *const kSettingsOrganization = "prir-projekt";
+const char *const kSettingsApplication = "slave";
+
+QString settingsGroup(const QString &host)
+{
+    return "autotune/" + host;
+}
+
+} // namespace
+
+/**
+ * Konstruktor klasy Autotuner.
+ * @param baseOptions Ustawienia puli wątków z interfejsu; próby zmieniają tylko liczbę wątków
+ */
+Autotuner::Autotuner(const WorkerPoolOptions &baseOptions, QObject *parent) :
+    QObject(parent),
+    m_baseOptions(baseOptions),
+    m_stop(new StopFlag)
+{
+}
+
+/**
+ * Odczytuje konfigurację zapisaną dla bieżącego hosta. Ustawienia mogą leżeć w katalogu domowym
+ * współdzielonym przez wiele węzłów, dlatego są zapisywane pod nazwą hosta. Konfiguracja
+ * zapisana przy innej liczbie procesorów jest pomijana.
+ * @return Zapisana konfiguracja lub konfiguracja niepoprawna (isValid() == false)
+ */
+TuningResult Autotuner::loadSaved()
+{
+    TuningResult result;
+    result.host = QSysInfo::machineHostName();
+
+    QSettings settings(kSettingsOrganization, kSettingsApplication);
+    settings.beginGroup(settingsGroup(result.host));
+    if (settings.value("cpus").toUInt() != static_cast<quint32>(detectCpuTopology().size()))
+        return result;
+
+    result.cpus = settings.value("cpus").toUInt();
+    result.threads = settings.value("threads").toUInt();
+    result.piecesPerThread = qMax(1u, settings.value("piecesPerThread").toUInt());
+    result.l1d = settings.value("l1d").toUInt();
+    result.l2 = settings.value("l2").toUInt();
+    result.l3 = settings.value("l3").toUInt();
+    result.numbersPerSecond = settings.value("numbersPerSecond").toDouble();
+    return result;
+}
+
+/**
+ * Zapisuje konfigurację dla hosta, na którym została wyznaczona.
+ */
+void Autotuner::save(const TuningResult &result)
+{
+    QSettings settings(kSettingsOrganization, kSettingsApplication);
+    settings.beginGroup(settingsGroup(result.host));
+    settings.setValue("cpus", result.cpus);
+    settings.setValue("threads", result.threads);
+    settings.setValue("piecesPerThread", result.piecesPerThread);
+    settings.setValue("l1d", result.l1d);
+    settings.setValue("l2", result.l2);
+    settings.setValue("l3", result.l3);
+    settings.setValue("numbersPerSecond", result.numbersPerSecond);
+}
+
+/**
+ * Przeprowadza strojenie metodą współrzędnych: najpierw liczba wątków (rdzenie fizyczne,
+ * ich połowa lub wszystkie procesory logiczne), potem liczba części fragmentu na wątek.
+ * Rozmiary pamięci podręcznej są tylko zgłaszane razem z wynikiem.
+ * Przerwanie wątku (requestInterruption) kończy strojenie z niepoprawnym wynikiem.
+ */
+void Autotuner::run()
+{
+    TuningResult result;
+    result.host = QSysInfo::machineHostName();
+
+    const QVector<CpuInfo> topology = detectCpuTopology();
+    result.cpus = static_cast<quint32>(topology.size());
+
+    const CacheSizes caches = detectCacheSizes();
+    result.l1d = caches.l1d;
+    result.l2 = caches.l2;
+    result.l3 = caches.l3;
+
+    emit progress(QString("Autotuning: %1 CPUs, L1d %2 KiB, L2 %3 KiB, L3 %4 KiB shared by %5 CPUs")
+                      .arg(result.cpus).arg(caches.l1d / 1024).arg(caches.l2 / 1024)
+                      .arg(caches.l3 / 1024).arg(caches.l3Sharing));
+
+    // Kandydaci liczby wątków; pula bez opcji physicalCoresOnly i tak obsadza najpierw rdzenie fizyczne,
+    // a z tą opcją wątki ponad liczbę rdzeni fizycznych dzieliłyby rdzenie z innymi wątkami puli
+    int physical = static_cast<int>(std::count_if(topology.begin(), topology.end(),
+                                                  [](const CpuInfo &info) { return info.primary; }));
+    int logical = m_baseOptions.physicalCoresOnly ? physical : topology.size();
+    if (m_baseOptions.reserveNetworkCore && logical > 1) {
+        logical--;
+        physical = qMax(1, physical - 1);
+    }
+    QVector<int> threadCandidates = {qMax(1, physical / 2), qMax(1, physical), qMax(1, logical)};
+    std::sort(threadCandidates.begin(), threadCandidates.end());
+    threadCandidates.erase(std::unique(threadCandidates.begin(), threadCandidates.end()), threadCandidates.end());
+
+    int bestThreads = threadCandidates.last();
+    int bestPieces = 2;
+    double best = 0;
+
+    for (int threads : threadCandidates) {
+        double rate = measure(threads, bestPieces);
+        if (m_stop->stopped) break;
+        if (rate > best) {
+            best = rate;
+            bestThreads = threads;
+        }
+    }
+
+    for (int pieces : kPiecesPerThreadCandidates) {
+        if (m_stop->stopped || pieces == 2) continue;
+        double rate = measure(bestThreads, pieces);
+        if (rate > best) {
+            best = rate;
+            bestPieces = pieces;
+        }
+    }
+
+    if (!m_stop->stopped) {
+        result.threads = static_cast<quint32>(bestThreads);
+        result.piecesPerThread = static_cast<quint32>(bestPieces);
+        result.numbersPerSecond = best;
+    }
+
+    emit finished(result);
+}
+
+/**
+ * Mierzy przepustowość jednej konfiguracji: zakres prób jest dzielony na threads * piecesPerThread
+ * części liczonych w osobnej puli. Zadania próbne nie mają odbiorcy (tryb CountOnly), więc
+ * wynik obejmuje tylko koszt obliczeń. Pula próbna nie rezerwuje rdzenia sieciowego, aby nie
+ * przypinać wątku autotunera; liczba wątków kandydatów uwzględnia już tę rezerwację.
+ * @return Najlepsza z kTrialRepeats przepustowość w liczbach na sekundę (0 po przerwaniu)
+ */
+double Autotuner::measure(int threads, int piecesPerThread)
+{
+    WorkerPoolOptions options = m_baseOptions;
+    options.threads = threads;
+    options.reserveNetworkCore = false;
+    WorkerPool pool(options);
+
+    double best = 0;
+    for (int repeat = 0; repeat < kTrialRepeats && !m_stop->stopped; repeat++) {
+        QElapsedTimer timer;
+        timer.start();
+
+        int pieces = threads * piecesPerThread;
+        quint64 rangePerPiece = kTrialNumbers / static_cast<quint64>(pieces);
+        for (int i = 0; i < pieces; i++) {
+            quint64 start = kTrialStart + i * rangePerPiece;
+            quint64 end = (i == pieces - 1) ? kTrialStart + kTrialNumbers - 1 : start + rangePerPiece - 1;
+
+            PrimeRunnable *task = new PrimeRunnable(nullptr, m_stop, start, end, PrimeRunnable::CountOnly);
+            task->setAutoDelete(true);
+            pool.start(task);
+        }
+
+        while (!pool.waitForDone(5)) {
+            if (QThread::currentThread()->isInterruptionRequested()) m_stop->stopped = true;
+        }
+
+        if (m_stop->stopped)
+            return 0;
+        best = qMax(best, static_cast<double>(kTrialNumbers) * 1e9 / qMax<qint64>(1, timer.nsecsElapsed()));
+    }
+
+    emit progress(QString("Trial: %1 threads, %2 pieces/thread: %3 M numbers/s")
+                      .arg(threads).arg(piecesPerThread).arg(best / 1e6, 0, 'f', 2));
+    return best;
+}
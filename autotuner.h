@@ -0,0 +1,41 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include "tuningresult.h"
+#include "workerpool.h"
+
+struct StopFlag;
+
+/**
+ * Dobiera konfigurację obliczeń slave'a do hosta. Na podstawie topologii procesorów z sysfs
+ * wyznacza kandydatów (liczba wątków, części fragmentu na wątek) i mierzy krótkie próby
+ * silnika PrimeRunnable na stałym zakresie.
+ * Działa we własnym wątku, bo próby blokują go na kilka sekund.
+ */
+class Autotuner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Autotuner(const WorkerPoolOptions &baseOptions, QObject *parent = nullptr);
+
+    static TuningResult loadSaved();
+    static void save(const TuningResult &result);
+
+public slots:
+    void run();
+
+signals:
+    void progress(const QString &message);
+    void finished(const TuningResult &result);
+
+private:
+    double measure(int threads, int piecesPerThread);
+
+    WorkerPoolOptions m_baseOptions;
+    QSharedPointer<StopFlag> m_stop;
+};
+
+#endif // AUTOTUNER_H
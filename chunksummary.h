@@ -0,0 +1,62 @@
+#ifndef CHUNKSUMMARY_H
+#define CHUNKSUMMARY_H
+
+#include <QDataStream>
+#include <QMetaType>
+
+/**
+ * Podsumowanie wyniku obliczeń dla jednego fragmentu zakresu [start, end].
+ * Suma kontrolna nie zależy od kolejności liczb pierwszych, więc master może ją policzyć
+ * z liczb odebranych w dowolnej kolejności i porównać z wartością wyliczoną przez slave'a.
+ */
+struct ChunkSummary
+{
+    // Rozmiar podsumowania w strumieniu QDataStream
+    static const int SerializedSize = 8 + 8 + 4 + 8 + 8;
+
+    quint64 start = 0;
+    quint64 end = 0;
+    quint32 count = 0;
+    quint64 sum = 0;    // suma liczb pierwszych modulo 2^64
+    quint64 hash = 0;   // XOR wymieszanych liczb pierwszych
+
+    void add(quint64 prime)
+    {
+        count++;
+        sum += prime;
+        hash ^= mix(prime);
+    }
+
+    bool isEmpty() const
+    {
+        return end < start;
+    }
+
+    bool sameResult(const ChunkSummary &other) const
+    {
+        return count == other.count && sum == other.sum && hash == other.hash;
+    }
+
+    // Funkcja mieszająca splitmix64 - rozprasza bity, aby XOR nie znosił się dla bliskich liczb
+    static quint64 mix(quint64 x)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const ChunkSummary &summary)
+{
+    return stream << summary.start << summary.end << summary.count << summary.sum << summary.hash;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, ChunkSummary &summary)
+{
+    return stream >> summary.start >> summary.end >> summary.count >> summary.sum >> summary.hash;
+}
+
+Q_DECLARE_METATYPE(ChunkSummary)
+
+#endif // CHUNKSUMMARY_H
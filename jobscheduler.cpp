@@ -0,0 +1,154 @@
+#include "jobscheduler.h"
+
+namespace {
+
+// Fragment obejmuje około 1/kChunksPerJob zakresu zadania, w granicach kMinChunkSize..kMaxChunkSize
+const quint64 kChunksPerJob = 128;
+const quint64 kMinChunkSize = 65536;
+const quint64 kMaxChunkSize = 10000000;
+
+// Krok przebiegu dla priorytetu o wadze 1; wagi priorytetów to 1, 4 i 16
+const quint64 kStrideBase = 1 << 20;
+
+} // namespace
+
+/**
+ * Zwraca ułamek zakresu zadania objęty zakończonymi fragmentami.
+ */
+double Job::progress() const
+{
+    double size = static_cast<double>(end - start) + 1.0;
+    return static_cast<double>(completed) / size;
+}
+
+/**
+ * Dodaje zadanie do kolejki.
+ * Przebieg nowego zadania zaczyna się od bieżącego czasu wirtualnego, dzięki czemu nie nadrabia
+ * czasu, w którym go nie było, ani nie czeka na zadania uruchomione wcześniej.
+ * @return Identyfikator zadania
+ */
+quint32 JobScheduler::addJob(JobType type, JobPriority priority, quint64 start, quint64 end, quint32 modulus)
+{
+    Job job;
+    job.id = m_nextId++;
+    job.type = type;
+    job.priority = priority;
+    job.start = start;
+    job.end = end;
+    job.modulus = modulus;
+    job.chunkSize = qBound(kMinChunkSize, (end - start) / kChunksPerJob + 1, kMaxChunkSize);
+    job.next = start;
+    job.pass = m_virtualTime;
+    job.timer.start();
+
+    m_jobs.insert(job.id, job);
+    return job.id;
+}
+
+/**
+ * Anuluje zadanie: nieprzydzielone fragmenty nie zostaną już wysłane.
+ * Fragmenty w trakcie obliczeń kończą się normalnie.
+ */
+void JobScheduler::cancelJob(quint32 jobId)
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end()) return;
+
+    it->cancelled = true;
+    it->retry.clear();
+}
+
+/**
+ * Wybiera kolejny fragment do przydzielenia: z zadania o najmniejszym przebiegu spośród zadań,
+ * które mają jeszcze nieprzydzieloną pracę. Fragmenty do ponownego przydziału mają pierwszeństwo.
+ * @return false jeśli żadne zadanie nie ma pracy do przydzielenia
+ */
+bool JobScheduler::nextTask(JobTask *task)
+{
+    Job *selected = nullptr;
+    for (Job &job : m_jobs) {
+        if (!job.hasWork()) continue;
+        if (!selected || job.pass < selected->pass) selected = &job;
+    }
+    if (!selected)
+        return false;
+
+    m_virtualTime = selected->pass;
+    selected->pass += stride(selected->priority);
+    selected->running++;
+
+    if (!selected->retry.isEmpty()) {
+        *task = selected->retry.takeFirst();
+        return true;
+    }
+
+    task->jobId = selected->id;
+    task->start = selected->next;
+    task->end = selected->end - selected->next < selected->chunkSize ? selected->end
+                                                                      : selected->next + selected->chunkSize - 1;
+    if (task->end == selected->end) {
+        selected->allAssigned = true;
+    } else {
+        selected->next = task->end + 1;
+    }
+    return true;
+}
+
+/**
+ * Kończy przydział fragmentu. Nieobliczone części (np. po rozłączeniu slave'a) wracają do kolejki.
+ * @param task Zakończony fragment
+ * @param unfinished Części fragmentu, dla których nie ma wyników
+ */
+void JobScheduler::taskFinished(const JobTask &task, const QVector<QPair<quint64, quint64>> &unfinished)
+{
+    auto it = m_jobs.find(task.jobId);
+    if (it == m_jobs.end()) return;
+
+    it->running--;
+
+    quint64 missing = 0;
+    for (const auto &range : unfinished) {
+        missing += range.second - range.first + 1;
+        if (it->cancelled) continue;
+
+        JobTask rest;
+        rest.jobId = task.jobId;
+        rest.start = range.first;
+        rest.end = range.second;
+        it->retry.append(rest);
+    }
+
+    it->completed += task.end - task.start + 1 - missing;
+}
+
+const Job *JobScheduler::job(quint32 jobId) const
+{
+    auto it = m_jobs.constFind(jobId);
+    return it == m_jobs.constEnd() ? nullptr : &it.value();
+}
+
+QList<quint32> JobScheduler::jobIds() const
+{
+    return m_jobs.keys();
+}
+
+bool JobScheduler::hasWork() const
+{
+    for (const Job &job : m_jobs) {
+        if (job.hasWork()) return true;
+    }
+    return false;
+}
+
+quint64 JobScheduler::stride(JobPriority priority)
+{
+    switch (priority) {
+    case JobPriority::Low:
+        return kStrideBase;
+    case JobPriority::High:
+        return kStrideBase / 16;
+    case JobPriority::Normal:
+        break;
+    }
+    return kStrideBase / 4;
+}
@@ -0,0 +1,81 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QVector>
+#include <QElapsedTimer>
+
+enum class JobType : quint8 {
+    Primes = 1,         // slave'y przesyłają każdą liczbę pierwszą
+    Statistics = 2      // slave'y przesyłają tylko statystyki fragmentów
+};
+
+enum class JobPriority {
+    Low,
+    Normal,
+    High
+};
+
+// Fragment zadania przydzielany jednemu slave'owi
+struct JobTask
+{
+    quint32 jobId = 0;
+    quint64 start = 0;
+    quint64 end = 0;
+};
+
+struct Job
+{
+    quint32 id = 0;
+    JobType type = JobType::Primes;
+    JobPriority priority = JobPriority::Normal;
+    quint64 start = 0;
+    quint64 end = 0;
+    quint32 modulus = 1;        // moduł rozkładu reszt (zadania statystyk)
+    quint64 chunkSize = 0;
+
+    quint64 next = 0;           // pierwsza nieprzydzielona liczba
+    bool allAssigned = false;   // cały zakres został już przydzielony
+    QList<JobTask> retry;       // fragmenty do ponownego przydziału
+    int running = 0;            // fragmenty przydzielone i niezakończone
+    quint64 completed = 0;      // liczby z zakończonych fragmentów
+    quint64 pass = 0;           // pozycja w planowaniu krokowym (stride scheduling)
+    bool cancelled = false;
+    QElapsedTimer timer;
+
+    bool hasWork() const { return !cancelled && (!allAssigned || !retry.isEmpty()); }
+    bool isFinished() const { return !hasWork() && running == 0; }
+    double progress() const;
+};
+
+/**
+ * Kolejka zadań mastera. Zadania są dzielone na fragmenty, a kolejne fragmenty pochodzą
+ * z zadania o najmniejszym „przebiegu” (stride scheduling): każdy przydzielony fragment
+ * przesuwa przebieg zadania o krok odwrotnie proporcjonalny do jego priorytetu. Zadania
+ * dzielą więc klaster proporcjonalnie do priorytetów, a nowe zadanie dostaje fragmenty od razu,
+ * bez przerywania już działających.
+ */
+class JobScheduler
+{
+public:
+    quint32 addJob(JobType type, JobPriority priority, quint64 start, quint64 end, quint32 modulus);
+    void cancelJob(quint32 jobId);
+
+    bool nextTask(JobTask *task);
+    void taskFinished(const JobTask &task, const QVector<QPair<quint64, quint64>> &unfinished);
+
+    const Job *job(quint32 jobId) const;
+    QList<quint32> jobIds() const;
+    bool hasWork() const;
+
+private:
+    static quint64 stride(JobPriority priority);
+
+    QMap<quint32, Job> m_jobs;
+    quint32 m_nextId = 1;
+    quint64 m_virtualTime = 0;  // przebieg zadania, z którego przydzielono ostatni fragment
+};
+
+#endif // JOBSCHEDULER_H
@@ -0,0 +1,558 @@
+#include "loadtest.h"
+#include "masterwidget.h"
+#include "shmring.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QTextStream>
+#include <QMutexLocker>
+#include <algorithm>
+#include <limits>
+
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/sockios.h>
+#endif
+
+namespace {
+
+// Maksymalna liczba bajtów oczekujących w buforze QTcpSocket, powyżej której slave wstrzymuje wysyłanie
+const qint64 kMaxUserBacklog = 8 * 1024 * 1024;
+
+// Rozmiar ramki z liczbą pierwszą (kod operacji + identyfikator zadania + quint64)
+const int kPrimeFrameSize = 1 + 4 + 8;
+
+// Rozmiar pierścienia pamięci współdzielonej symulowanego slave'a
+const quint32 kRingCapacity = 8 * 1024 * 1024;
+
+/**
+ * Zwraca czas procesora (użytkownika + systemu) w mikrosekundach.
+ * @param who RUSAGE_THREAD dla bieżącego wątku lub RUSAGE_SELF dla całego procesu
+ */
+qint64 cpuTimeUs(int who)
+{
+#ifdef Q_OS_LINUX
+    struct rusage usage;
+    if (getrusage(who, &usage) != 0)
+        return 0;
+
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000
+           + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#else
+    Q_UNUSED(who);
+    return 0;
+#endif
+}
+
+#ifndef Q_OS_LINUX
+const int RUSAGE_THREAD = 0;
+const int RUSAGE_SELF = 0;
+#endif
+
+/**
+ * Zwraca wartość percentyla z posortowanego wektora.
+ */
+qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) return 0;
+
+    int index = qBound(0, static_cast<int>(p / 100.0 * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted[index];
+}
+
+} // namespace
+
+/**
+ * Konstruktor klasy SimulatedSlave - zapamiętuje parametry symulacji.
+ * Gniazdo i zegary tworzone są dopiero w start(), czyli w wątku, do którego slave został przeniesiony.
+ * @param id Numer symulowanego slave'a
+ * @param options Parametry testu obciążeniowego
+ * @param clock Wspólny zegar testu, z którego liczone są opóźnienia
+ */
+SimulatedSlave::SimulatedSlave(int id, const LoadTestOptions &options, const QElapsedTimer *clock,
+                               QObject *parent) :
+    QObject(parent),
+    m_id(id),
+    m_jobId(0),
+    m_options(options),
+    m_clock(clock),
+    m_socket(nullptr),
+    m_ring(nullptr),
+    m_sendTimer(nullptr),
+    m_sampleTimer(nullptr),
+    m_startNs(0),
+    m_nextPrime(3),
+    m_framesSent(0),
+    m_chunksSent(0),
+    m_kernelQueueSum(0),
+    m_kernelQueueMax(0),
+    m_userQueueSum(0),
+    m_userQueueMax(0),
+    m_samples(0)
+{
+}
+
+SimulatedSlave::~SimulatedSlave()
+{
+    delete m_ring;
+}
+
+/**
+ * Zwraca lokalny port gniazda, po którym master identyfikuje tego slave'a.
+ */
+quint16 SimulatedSlave::localPort() const
+{
+    return m_socket ? m_socket->localPort() : 0;
+}
+
+/**
+ * Pobiera znacznik czasu rozpoczęcia najstarszego niepotwierdzonego fragmentu.
+ * Wywoływana z wątku mastera, gdy master zgłosi zakończenie fragmentu przez tego slave'a.
+ * @return Czas rozpoczęcia fragmentu w nanosekundach lub -1 jeśli kolejka jest pusta
+ */
+qint64 SimulatedSlave::takeChunkStart()
+{
+    QMutexLocker locker(&m_chunkMutex);
+    return m_chunkStarts.isEmpty() ? -1 : m_chunkStarts.dequeue();
+}
+
+/**
+ * Łączy się z masterem przez interfejs loopback i po nawiązaniu połączenia
+ * rozpoczyna odtwarzanie syntetycznego strumienia wyników. W trybie pamięci współdzielonej
+ * najpierw proponuje masterowi pierścień, tak jak prawdziwy slave, i czeka na odpowiedź.
+ * @param port Port, na którym nasłuchuje master
+ * @param jobId Zadanie mastera, do którego należą wysyłane wyniki
+ */
+void SimulatedSlave::start(quint16 port, quint32 jobId)
+{
+    m_jobId = jobId;
+
+    m_socket = new QTcpSocket(this);
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    m_sendTimer = new QTimer(this);
+    m_sendTimer->setTimerType(Qt::PreciseTimer);
+    m_sendTimer->setInterval(1);
+    connect(m_sendTimer, &QTimer::timeout, this, &SimulatedSlave::sendBatch);
+
+    m_sampleTimer = new QTimer(this);
+    m_sampleTimer->setInterval(100);
+    connect(m_sampleTimer, &QTimer::timeout, this, &SimulatedSlave::sampleQueues);
+
+    connect(m_socket, &QTcpSocket::readyRead, this, &SimulatedSlave::handleData);
+    connect(m_socket, &QTcpSocket::connected, this, [this]() {
+        if (!m_options.sharedMemory) {
+            beginSending();
+            return;
+        }
+
+        ShmRing *ring = new ShmRing;
+        const QString name = ShmRing::makeName(QString("loadtest-%1-%2").arg(QCoreApplication::applicationPid()).arg(m_id));
+        if (!ring->create(name, kRingCapacity)) {
+            QTextStream(stderr) << "Slave " << m_id << ": shared memory unavailable: " << ring->errorString() << "\n";
+            delete ring;
+            beginSending();
+            return;
+        }
+        m_ring = ring;
+
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << quint8(7) << name; // 7 = kod operacji propozycji pamięci współdzielonej
+        m_socket->write(data);
+    });
+
+    m_socket->connectToHost(QHostAddress::LocalHost, port);
+}
+
+/**
+ * Rozpoczyna pomiar po nawiązaniu połączenia (i ustaleniu transportu).
+ */
+void SimulatedSlave::beginSending()
+{
+    m_startNs = m_clock->nsecsElapsed();
+    m_sendTimer->start();
+    m_sampleTimer->start();
+    emit connected(m_id, m_socket->localPort());
+}
+
+/**
+ * Odczytuje ramki mastera. Fragmenty zadań są pomijane - symulowany slave wysyła własny
+ * strumień wyników; istotna jest tylko odpowiedź na propozycję pamięci współdzielonej.
+ */
+void SimulatedSlave::handleData()
+{
+    QDataStream stream(m_socket);
+
+    forever {
+        stream.startTransaction();
+
+        quint8 opCode = 0;
+        stream >> opCode;
+
+        if (opCode == 1) {
+            quint32 jobId, modulus;
+            quint8 type;
+            quint64 start, end;
+            stream >> jobId >> type >> start >> end >> modulus;
+            if (!stream.commitTransaction())
+                return;
+
+        } else if (opCode == 3) {
+            quint32 requestId;
+            quint64 start, end;
+            stream >> requestId >> start >> end;
+            if (!stream.commitTransaction())
+                return;
+
+        } else if (opCode == 4) {
+            quint64 start, end;
+            stream >> start >> end;
+            if (!stream.commitTransaction())
+                return;
+
+        } else if (opCode == 5) {
+            quint8 accepted;
+            stream >> accepted;
+            if (!stream.commitTransaction())
+                return;
+
+            if (!m_ring || m_sendTimer->isActive())
+                continue;
+
+            m_ring->unlink();
+            if (!accepted) {
+                QTextStream(stderr) << "Slave " << m_id << ": master rejected shared memory, using TCP\n";
+                delete m_ring;
+                m_ring = nullptr;
+            }
+            beginSending();
+
+        } else if (!stream.commitTransaction()) {
+            return;
+        }
+    }
+}
+
+/**
+ * Zatrzymuje wysyłanie. Dane zapisane już do gniazda są nadal przekazywane masterowi.
+ */
+void SimulatedSlave::stop()
+{
+    if (m_sendTimer) m_sendTimer->stop();
+    if (m_sampleTimer) m_sampleTimer->stop();
+}
+
+/**
+ * Wysyła porcję ramek tak, aby średnie tempo odpowiadało zadanemu w opcjach.
+ * Co chunkSize ramek z liczbami pierwszymi dopisuje ramkę zakończenia fragmentu (kod operacji 2),
+ * identyczną z tą, którą wysyła prawdziwy slave.
+ */
+void SimulatedSlave::sendBatch()
+{
+    if (m_socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    if (m_ring) {
+        // Wyniki czekające na miejsce w pierścieniu wstrzymują generowanie nowych
+        writeToRing(QByteArray());
+        if (!m_ringBacklog.isEmpty())
+            return;
+    } else if (m_socket->bytesToWrite() > kMaxUserBacklog) {
+        return;
+    }
+
+    qint64 elapsedNs = m_clock->nsecsElapsed() - m_startNs;
+    quint64 due = static_cast<quint64>(static_cast<double>(m_options.rate) * elapsedNs / 1e9);
+    if (due <= m_framesSent)
+        return;
+
+    // Ograniczenie porcji do 10 ms ruchu, aby po przestoju nie wysyłać jednego ogromnego bloku
+    quint64 batch = qMin<quint64>(due - m_framesSent, qMax(1, m_options.rate / 100));
+
+    QByteArray data;
+    data.reserve(static_cast<int>(batch) * kPrimeFrameSize + 64);
+    QDataStream stream(&data, QIODevice::WriteOnly);
+
+    for (quint64 i = 0; i < batch; i++) {
+        if (m_chunk.count == 0) {
+            QMutexLocker locker(&m_chunkMutex);
+            m_chunkStarts.enqueue(m_clock->nsecsElapsed());
+            m_chunk.start = m_nextPrime;
+        }
+
+        stream << quint8(1) << m_jobId << m_nextPrime;
+        m_chunk.add(m_nextPrime);
+        m_chunk.end = m_nextPrime;
+        m_nextPrime += 2;
+
+        if (m_chunk.count == static_cast<quint32>(m_options.chunkSize)) {
+            stream << quint8(2) << m_jobId << m_chunk;
+            m_chunk = ChunkSummary();
+            m_chunksSent++;
+        }
+    }
+
+    if (m_ring)
+        writeToRing(data);
+    else
+        m_socket->write(data);
+    m_framesSent += batch;
+}
+
+/**
+ * Zapisuje dane w blokach pierścienia, a to, co się nie zmieściło, zostawia w kolejce.
+ * Jeśli master czeka na dzwonek, wysyła go przez połączenie TCP (kod operacji 8).
+ */
+void SimulatedSlave::writeToRing(const QByteArray &data)
+{
+    m_ringBacklog.append(data);
+
+    int written = 0;
+    while (written < m_ringBacklog.size()) {
+        quint32 size = qMin<quint32>(m_ring->maxBlockSize(), static_cast<quint32>(m_ringBacklog.size() - written));
+        if (!m_ring->write(m_ringBacklog.constData() + written, size))
+            break;
+        written += static_cast<int>(size);
+    }
+    m_ringBacklog.remove(0, written);
+
+    if (written > 0 && m_ring->takeDoorbell()) {
+        const char doorbell = 8; // 8 = kod operacji dzwonka pierścienia
+        m_socket->write(&doorbell, 1);
+    }
+}
+
+/**
+ * Próbkuje zajętość buforów: liczbę bajtów w buforze QTcpSocket oraz w kolejce nadawczej jądra.
+ * Na interfejsie loopback kolejka nadawcza odpowiada danym, których master jeszcze nie odczytał.
+ */
+void SimulatedSlave::sampleQueues()
+{
+    quint64 userQueue = static_cast<quint64>(m_socket->bytesToWrite() + m_ringBacklog.size());
+    quint64 kernelQueue = 0;
+
+#ifdef Q_OS_LINUX
+    int value = 0;
+    if (ioctl(static_cast<int>(m_socket->socketDescriptor()), SIOCOUTQ, &value) == 0)
+        kernelQueue = static_cast<quint64>(value);
+#endif
+
+    m_userQueueSum += userQueue;
+    m_userQueueMax = qMax(m_userQueueMax, userQueue);
+    m_kernelQueueSum += kernelQueue;
+    m_kernelQueueMax = qMax(m_kernelQueueMax, kernelQueue);
+    m_samples++;
+}
+
+/**
+ * Konstruktor klasy LoadTest - tworzy rdzeń mastera i symulowane slave'y.
+ * Slave'y działają we własnym wątku, dzięki czemu pętla zdarzeń mastera obsługuje wyłącznie
+ * przyjmowanie wyników, tak jak w rzeczywistym klastrze.
+ * @param options Parametry testu obciążeniowego
+ */
+LoadTest::LoadTest(const LoadTestOptions &options, QObject *parent) :
+    QObject(parent),
+    m_options(options),
+    m_master(new MasterWidget),
+    m_startNs(0),
+    m_stopNs(0),
+    m_lastIngestNs(0),
+    m_connected(0),
+    m_lastPrimeCount(0),
+    m_chunksFinished(0),
+    m_masterCpuStartUs(0),
+    m_processCpuStartUs(0)
+{
+    m_clock.start();
+
+    connect(m_master, &MasterWidget::slaveFinished, this, &LoadTest::handleSlaveFinished);
+
+    for (int i = 0; i < m_options.slaves; i++) {
+        SimulatedSlave *slave = new SimulatedSlave(i, m_options, &m_clock);
+        slave->moveToThread(&m_slaveThread);
+        connect(&m_slaveThread, &QThread::finished, slave, &QObject::deleteLater);
+        connect(slave, &SimulatedSlave::connected, this, &LoadTest::handleSlaveConnected);
+        m_slaves.append(slave);
+    }
+}
+
+/**
+ * Destruktor klasy LoadTest - zatrzymuje wątek slave'ów i zwalnia rdzeń mastera.
+ */
+LoadTest::~LoadTest()
+{
+    m_slaveThread.quit();
+    m_slaveThread.wait();
+
+    delete m_master;
+}
+
+/**
+ * Uruchamia test: startuje serwer mastera na losowym porcie loopback, dodaje zadanie obejmujące
+ * syntetyczny strumień wyników i łączy z nim slave'y.
+ */
+void LoadTest::start()
+{
+    if (m_options.showMaster)
+        m_master->show();
+
+    if (!m_master->startServer(0, QHostAddress::LocalHost)) {
+        QTextStream(stderr) << "Could not start master: " << m_master->serverError() << "\n";
+        QCoreApplication::exit(1);
+        return;
+    }
+
+    QTextStream(stdout) << QString("Load test: %1 slaves x %2 frames/s, %3 primes per chunk, %4 s, %5 transport\n")
+                               .arg(m_options.slaves).arg(m_options.rate)
+                               .arg(m_options.chunkSize).arg(m_options.duration)
+                               .arg(m_options.sharedMemory ? "shared-memory" : "TCP");
+
+    // Wyniki nieznanych zadań master pomija, więc strumień slave'ów musi należeć do zadania
+    quint32 jobId = m_master->addJob(JobType::Primes, JobPriority::Normal, 3,
+                                     std::numeric_limits<quint64>::max() / 2);
+
+    m_slaveThread.start();
+
+    for (SimulatedSlave *slave : m_slaves) {
+        QMetaObject::invokeMethod(slave, "start", Qt::QueuedConnection,
+                                  Q_ARG(quint16, m_master->serverPort()),
+                                  Q_ARG(quint32, jobId));
+    }
+}
+
+/**
+ * Rejestruje połączenie slave'a. Po połączeniu wszystkich slave'ów rozpoczyna pomiar.
+ */
+void LoadTest::handleSlaveConnected(int id, quint16 localPort)
+{
+    m_slavesByPort[localPort] = m_slaves[id];
+
+    if (++m_connected < m_slaves.size())
+        return;
+
+    m_startNs = m_clock.nsecsElapsed();
+    m_masterCpuStartUs = cpuTimeUs(RUSAGE_THREAD);
+    m_processCpuStartUs = cpuTimeUs(RUSAGE_SELF);
+
+    QTimer::singleShot(m_options.duration * 1000, this, &LoadTest::stopSlaves);
+}
+
+/**
+ * Rejestruje zakończenie fragmentu zgłoszone przez mastera i wylicza jego opóźnienie end-to-end,
+ * czyli czas od wysłania pierwszej liczby fragmentu do przetworzenia ramki zakończenia przez mastera.
+ */
+void LoadTest::handleSlaveFinished(const QString &address, quint32 count)
+{
+    Q_UNUSED(count);
+
+    quint16 port = static_cast<quint16>(address.mid(address.lastIndexOf(':') + 1).toUInt());
+    SimulatedSlave *slave = m_slavesByPort.value(port);
+    if (!slave) return;
+
+    qint64 startNs = slave->takeChunkStart();
+    if (startNs < 0) return;
+
+    m_latenciesNs.append(m_clock.nsecsElapsed() - startNs);
+    m_chunksFinished++;
+}
+
+/**
+ * Kończy fazę wysyłania i czeka, aż master przetworzy wszystkie wysłane ramki.
+ */
+void LoadTest::stopSlaves()
+{
+    for (SimulatedSlave *slave : m_slaves) {
+        QMetaObject::invokeMethod(slave, "stop", Qt::BlockingQueuedConnection);
+    }
+
+    m_stopNs = m_clock.nsecsElapsed();
+    m_lastPrimeCount = m_master->primeCount();
+    m_lastIngestNs = m_stopNs;
+
+    checkDrained();
+}
+
+/**
+ * Sprawdza, czy master odebrał wszystkie wysłane ramki. Jeśli nie - ponawia sprawdzenie
+ * do upływu drainTimeout, a następnie drukuje raport i kończy aplikację.
+ */
+void LoadTest::checkDrained()
+{
+    quint64 framesSent = 0;
+    quint64 chunksSent = 0;
+    for (SimulatedSlave *slave : m_slaves) {
+        framesSent += slave->framesSent();
+        chunksSent += slave->chunksSent();
+    }
+
+    int primeCount = m_master->primeCount();
+    if (primeCount != m_lastPrimeCount) {
+        m_lastPrimeCount = primeCount;
+        m_lastIngestNs = m_clock.nsecsElapsed();
+    }
+
+    bool drained = static_cast<quint64>(primeCount) >= framesSent && m_chunksFinished >= chunksSent;
+    bool timedOut = m_clock.nsecsElapsed() - m_stopNs > qint64(m_options.drainTimeout) * 1000000000;
+
+    if (!drained && !timedOut) {
+        QTimer::singleShot(10, this, &LoadTest::checkDrained);
+        return;
+    }
+
+    report();
+    QCoreApplication::exit(drained ? 0 : 2);
+}
+
+/**
+ * Drukuje raport z pomiaru na standardowe wyjście.
+ */
+void LoadTest::report()
+{
+    qint64 masterCpuUs = cpuTimeUs(RUSAGE_THREAD) - m_masterCpuStartUs;
+    qint64 processCpuUs = cpuTimeUs(RUSAGE_SELF) - m_processCpuStartUs;
+
+    quint64 framesSent = 0;
+    quint64 chunksSent = 0;
+    quint64 kernelSum = 0, kernelMax = 0, userSum = 0, userMax = 0, samples = 0;
+    for (SimulatedSlave *slave : m_slaves) {
+        framesSent += slave->framesSent();
+        chunksSent += slave->chunksSent();
+        kernelSum += slave->kernelQueueSum();
+        kernelMax = qMax(kernelMax, slave->kernelQueueMax());
+        userSum += slave->userQueueSum();
+        userMax = qMax(userMax, slave->userQueueMax());
+        samples += slave->samples();
+    }
+
+    quint64 ingested = static_cast<quint64>(m_master->primeCount());
+    quint64 messages = ingested + m_chunksFinished;
+    double sendSeconds = (m_stopNs - m_startNs) / 1e9;
+    double ingestSeconds = qMax<qint64>(1, m_lastIngestNs - m_startNs) / 1e9;
+
+    std::sort(m_latenciesNs.begin(), m_latenciesNs.end());
+
+    QTextStream out(stdout);
+    out << QString("Frames sent:          %1 primes, %2 chunks (%3 frames/s)\n")
+               .arg(framesSent).arg(chunksSent).arg(framesSent / sendSeconds, 0, 'f', 0);
+    out << QString("Master ingested:      %1 primes, %2 chunks%3\n")
+               .arg(ingested).arg(m_chunksFinished)
+               .arg(ingested < framesSent ? " (INCOMPLETE - drain timeout)" : "");
+    out << QString("Ingest throughput:    %1 frames/s, %2 MB/s\n")
+               .arg(ingested / ingestSeconds, 0, 'f', 0)
+               .arg(ingested * kPrimeFrameSize / ingestSeconds / 1e6, 0, 'f', 2);
+    out << QString("Chunk latency (ms):   p50 %1, p90 %2, p99 %3, max %4\n")
+               .arg(percentile(m_latenciesNs, 50) / 1e6, 0, 'f', 2)
+               .arg(percentile(m_latenciesNs, 90) / 1e6, 0, 'f', 2)
+               .arg(percentile(m_latenciesNs, 99) / 1e6, 0, 'f', 2)
+               .arg(percentile(m_latenciesNs, 100) / 1e6, 0, 'f', 2);
+    out << QString("Socket backlog (KB):  kernel avg %1 max %2, user avg %3 max %4\n")
+               .arg(samples ? kernelSum / samples / 1024.0 : 0.0, 0, 'f', 1)
+               .arg(kernelMax / 1024.0, 0, 'f', 1)
+               .arg(samples ? userSum / samples / 1024.0 : 0.0, 0, 'f', 1)
+               .arg(userMax / 1024.0, 0, 'f', 1);
+    out << QString("CPU per message (us): master thread %1, process %2\n")
+               .arg(messages ? double(masterCpuUs) / messages : 0.0, 0, 'f', 3)
+               .arg(messages ? double(processCpuUs) / messages : 0.0, 0, 'f', 3);
+    out.flush();
+}
@@ -0,0 +1,131 @@
+#ifndef LOADTEST_H
+#define LOADTEST_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QMap>
+#include "chunksummary.h"
+
+class MasterWidget;
+class ShmRing;
+
+struct LoadTestOptions
+{
+    int slaves = 4;             // liczba symulowanych slave'ów
+    int rate = 100000;          // liczba ramek z liczbami pierwszymi na sekundę na slave'a
+    int chunkSize = 10000;      // liczba liczb pierwszych w jednym fragmencie (chunku)
+    int duration = 10;          // czas trwania pomiaru w sekundach
+    int drainTimeout = 5;       // maksymalny czas oczekiwania na opróżnienie kolejek w sekundach
+    bool showMaster = false;    // czy wyświetlać okno mastera podczas testu
+    bool sharedMemory = false;  // czy slave'y wysyłają wyniki przez pierścień pamięci współdzielonej
+};
+
+class SimulatedSlave : public QObject
+{
+    Q_OBJECT
+
+public:
+    SimulatedSlave(int id, const LoadTestOptions &options, const QElapsedTimer *clock,
+                   QObject *parent = nullptr);
+    ~SimulatedSlave();
+
+    quint16 localPort() const;
+    qint64 takeChunkStart();
+
+    // Statystyki dostępne po zatrzymaniu slave'a
+    quint64 framesSent() const { return m_framesSent; }
+    quint64 chunksSent() const { return m_chunksSent; }
+    quint64 kernelQueueSum() const { return m_kernelQueueSum; }
+    quint64 kernelQueueMax() const { return m_kernelQueueMax; }
+    quint64 userQueueSum() const { return m_userQueueSum; }
+    quint64 userQueueMax() const { return m_userQueueMax; }
+    quint64 samples() const { return m_samples; }
+
+public slots:
+    void start(quint16 port, quint32 jobId);
+    void stop();
+
+signals:
+    void connected(int id, quint16 localPort);
+
+private slots:
+    void handleData();
+    void sendBatch();
+    void sampleQueues();
+
+private:
+    int m_id;
+    quint32 m_jobId;
+    LoadTestOptions m_options;
+    const QElapsedTimer *m_clock;
+
+    QTcpSocket *m_socket;
+    ShmRing *m_ring;
+    QByteArray m_ringBacklog;
+    QTimer *m_sendTimer;
+    QTimer *m_sampleTimer;
+    qint64 m_startNs;
+
+    quint64 m_nextPrime;
+    quint64 m_framesSent;
+    quint64 m_chunksSent;
+    ChunkSummary m_chunk;
+
+    quint64 m_kernelQueueSum;
+    quint64 m_kernelQueueMax;
+    quint64 m_userQueueSum;
+    quint64 m_userQueueMax;
+    quint64 m_samples;
+
+    mutable QMutex m_chunkMutex;
+    QQueue<qint64> m_chunkStarts;
+
+    void beginSending();
+    void writeToRing(const QByteArray &data);
+};
+
+class LoadTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LoadTest(const LoadTestOptions &options, QObject *parent = nullptr);
+    ~LoadTest();
+
+    void start();
+
+private slots:
+    void handleSlaveConnected(int id, quint16 localPort);
+    void handleSlaveFinished(const QString &address, quint32 count);
+    void stopSlaves();
+    void checkDrained();
+
+private:
+    LoadTestOptions m_options;
+    MasterWidget *m_master;
+    QThread m_slaveThread;
+    QVector<SimulatedSlave*> m_slaves;
+    QMap<quint16, SimulatedSlave*> m_slavesByPort;
+
+    QElapsedTimer m_clock;
+    qint64 m_startNs;
+    qint64 m_stopNs;
+    qint64 m_lastIngestNs;
+    int m_connected;
+    int m_lastPrimeCount;
+    quint64 m_chunksFinished;
+    QVector<qint64> m_latenciesNs;
+
+    qint64 m_masterCpuStartUs;
+    qint64 m_processCpuStartUs;
+
+    void report();
+};
+
+#endif // LOADTEST_H
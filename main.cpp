@@ -1,10 +1,56 @@
 #include "mainwindow.h"
+#include "loadtest.h"
+#include "metrics.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+
+    // Test obciążeniowy: master i symulowane slave'y w jednym procesie, połączone przez loopback
+    QCommandLineOption loadTestOption("loadtest", "Run the in-process loopback load test and exit.");
+    QCommandLineOption slavesOption("slaves", "Number of simulated slaves.", "count", "4");
+    QCommandLineOption rateOption("rate", "Prime frames per second sent by each simulated slave.", "frames", "100000");
+    QCommandLineOption chunkOption("chunk", "Primes per chunk before a finish frame is sent.", "primes", "10000");
+    QCommandLineOption durationOption("duration", "Measurement time in seconds.", "seconds", "10");
+    QCommandLineOption showMasterOption("show-master", "Show the master widget during the load test.");
+    QCommandLineOption shmOption("shm", "Send load test results through shared-memory rings instead of TCP.");
+    parser.addOptions({loadTestOption, slavesOption, rateOption, chunkOption, durationOption, showMasterOption,
+                       shmOption});
+
+    // Endpoint HTTP z metrykami (format Prometheusa pod /metrics, JSON pod /metrics.json); domyślnie wyłączony,
+    // bo master i slave na jednym hoście konkurowałyby o ten sam port
+    QCommandLineOption metricsPortOption("metrics-port", "Local HTTP port serving runtime metrics (0 disables, e.g. 9464).",
+                                         "port", "0");
+    parser.addOption(metricsPortOption);
+    parser.process(a);
+
+    MetricsServer metricsServer;
+    quint16 metricsPort = static_cast<quint16>(parser.value(metricsPortOption).toUInt());
+    if (metricsPort != 0 && !metricsServer.start(metricsPort)) {
+        qWarning("Could not start metrics endpoint on port %u: %s", unsigned(metricsPort),
+                 qPrintable(metricsServer.errorString()));
+    }
+
+    if (parser.isSet(loadTestOption)) {
+        LoadTestOptions options;
+        options.slaves = qMax(1, parser.value(slavesOption).toInt());
+        options.rate = qMax(1, parser.value(rateOption).toInt());
+        options.chunkSize = qMax(1, parser.value(chunkOption).toInt());
+        options.duration = qMax(1, parser.value(durationOption).toInt());
+        options.showMaster = parser.isSet(showMasterOption);
+        options.sharedMemory = parser.isSet(shmOption);
+
+        LoadTest loadTest(options);
+        loadTest.start();
+        return a.exec();
+    }
+
     MainWindow w;
     w.show();
     return a.exec();
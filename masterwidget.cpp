@@ -1,7 +1,48 @@
 #include "masterwidget.h"
 #include "ui_masterwidget.h"
+#include "metrics.h"
+#include "queryserver.h"
+#include "primecodec.h"
+#include "shmring.h"
+#include "uiupdater.h"
 #include <QMessageBox>
+#include <QBuffer>
 #include <QDataStream>
+#include <QRandomGenerator>
+#include <QSignalBlocker>
+#include <algorithm>
+
+namespace {
+
+// Najmniejsza część zakresu zapytania wysyłana jednemu slave'owi
+const quint64 kMinQueryPiece = 1 << 20;
+
+// Liczba fragmentów zadań jednocześnie przydzielonych jednemu slave'owi: kolejny fragment
+// czeka już u slave'a, gdy ten kończy poprzedni
+const int kTasksPerSlave = 2;
+
+// Liczba bajtów pierścienia slave'a przetwarzana w jednym przebiegu pętli zdarzeń
+const quint64 kMaxRingDrainBytes = 4 * 1024 * 1024;
+
+QString jobTypeName(JobType type)
+{
+    return type == JobType::Statistics ? "Statistics" : "Primes";
+}
+
+QString priorityName(JobPriority priority)
+{
+    switch (priority) {
+    case JobPriority::Low:
+        return "Low";
+    case JobPriority::High:
+        return "High";
+    case JobPriority::Normal:
+        break;
+    }
+    return "Normal";
+}
+
+} // namespace
 
 /**
  * Konstruktor klasy MasterWidget - inicjalizuje interfejs użytkownika i konfiguruje serwer TCP.
@@ -14,15 +55,43 @@ MasterWidget::MasterWidget(QWidget *parent) :
     m_serverRunning(false),
 
 
-    m_rangeStart(1),
-    m_rangeEnd(1000000),
-    m_sortAscending(true)
+    m_sortAscending(true),
+    m_primesSorted(false),
+    m_selectedJob(0),
+    m_nextVerificationId(0),
+    m_verifyConfirmed(0),
+    m_verifyFailed(0),
+    m_verifyLost(0),
+    m_nextQueryClient(0)
 {
     ui->setupUi(this);
 
+    // Dziennik, licznik, lista liczb pierwszych i tabele są odświeżane zbiorczo kilkanaście razy na sekundę
+    m_uiUpdater = new UiUpdater(ui->logTextEdit, this);
+    m_uiUpdater->setView(PrimeCountView, [this]() { updatePrimeCount(); });
+    m_uiUpdater->setView(PrimesListView, [this]() { appendPrimesList(); });
+    m_uiUpdater->setView(JobTableView, [this]() { updateJobTable(); });
+    m_uiUpdater->setView(ClientListView, [this]() { updateClientList(); });
+
     // Inicjalizacja komponentów sieciowych
     m_server = new QTcpServer(this);
     connect(m_server, &QTcpServer::newConnection, this, &MasterWidget::handleNewConnection);
+
+    // Serwer zapytań działa we własnym wątku i tylko czyta m_store, więc nie blokuje odbioru wyników
+    m_queryServer = new QueryServer(&m_store);
+    m_queryServer->moveToThread(&m_queryThread);
+    connect(&m_queryThread, &QThread::finished, m_queryServer, &QObject::deleteLater);
+    connect(m_queryServer, &QueryServer::rangeRequested, this, &MasterWidget::dispatchQueryRange);
+    m_queryThread.start();
+
+    // Metryki globalne mastera
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    m_primesIngested = metrics.counter("prime_master_primes_received_total", "Primes received by the master");
+    m_connectedSlaves = metrics.gauge("prime_master_connected_slaves", "Slaves currently connected to the master");
+    m_chunkLatency = metrics.histogram("prime_master_chunk_latency_seconds",
+                                       "Time from dispatching a chunk to a slave to receiving all of its results",
+                                       {10, 100, 500, 1000, 5000, 10000, 30000, 60000, 300000, 900000},
+                                       1e-3);
 }
 
 /**
@@ -34,127 +103,495 @@ MasterWidget::~MasterWidget()
     // Zatrzymanie serwera i zamknięcie połączeń
 
     if (m_serverRunning) {
-        on_stopServerButton_clicked();
+        stopServer();
     }
 
+    m_queryThread.quit();
+    m_queryThread.wait();
+
     delete ui;
 }
 
 /**
  * Obsługuje kliknięcie przycisku uruchamiającego serwer.
- * Uruchamia serwer TCP na określonym porcie i aktualizuje interfejs użytkownika.
+ * Uruchamia serwer TCP na porcie wybranym w interfejsie użytkownika.
  * W przypadku błędu wyświetla komunikat z informacją o problemie.
  */
 void MasterWidget::on_startServerButton_clicked()
 {
-    int port = ui->portSpinBox->value();
+    if (!startServer(ui->portSpinBox->value())) {
+        QMessageBox::critical(this, "Error", "Could not start server: " + serverError());
+    }
+}
 
-    if (!m_server->listen(QHostAddress::Any, port)) {
-        QMessageBox::critical(this, "Error", "Could not start server: " + m_server->errorString());
-        return;
+/**
+ * Obsługuje kliknięcie przycisku zatrzymującego serwer.
+ */
+void MasterWidget::on_stopServerButton_clicked()
+{
+    stopServer();
+}
+
+/**
+ * Uruchamia serwer TCP na podanym adresie i porcie oraz aktualizuje interfejs użytkownika.
+ * Port 0 oznacza port wybrany przez system - faktyczny numer zwraca serverPort().
+ * @param port Port nasłuchiwania
+ * @param address Adres nasłuchiwania
+ * @return true jeśli serwer został uruchomiony
+ */
+bool MasterWidget::startServer(quint16 port, const QHostAddress &address)
+{
+    if (!m_server->listen(address, port)) {
+        log(QString("Could not start server: %1").arg(m_server->errorString()));
+        return false;
     }
 
     m_serverRunning = true;
-
+    port = m_server->serverPort();
+
+    quint16 queryPort = ui->queryPortSpinBox->value();
+    if (queryPort != 0) {
+        bool ok = false;
+        QString error;
+        QMetaObject::invokeMethod(m_queryServer, [&]() {
+            ok = m_queryServer->listen(queryPort, address);
+            error = m_queryServer->errorString();
+        }, Qt::BlockingQueuedConnection);
+
+        if (ok) {
+            log(QString("Query service listening on port %1").arg(queryPort));
+        } else {
+            log(QString("Could not start query service: %1").arg(error));
+        }
+    }
 
     ui->startServerButton->setEnabled(false);
     ui->stopServerButton->setEnabled(true);
     ui->distributeButton->setEnabled(true);
     ui->portSpinBox->setEnabled(false);
+    ui->queryPortSpinBox->setEnabled(false);
 
     log(QString("Server started on port %1").arg(port));
     ui->statusLabel->setText(QString("Server running on port %1").arg(port));
+    return true;
 }
 
 /**
- * Obsługuje kliknięcie przycisku zatrzymującego serwer.
- * Zamyka wszystkie połączenia z klientami, zatrzymuje serwer TCP i aktualizuje interfejs użytkownika.
+ * Zatrzymuje serwer TCP.
+ * Zamyka wszystkie połączenia z klientami i aktualizuje interfejs użytkownika.
  * Czyści listy klientów i aktualizuje informacje o stanie serwera.
  */
-void MasterWidget::on_stopServerButton_clicked()
+void MasterWidget::stopServer()
 {
-    for (QTcpSocket *socket : m_clients) {
+    // Fragmenty przydzielone slave'om wracają do kolejki zadań; wyniki czekające
+    // w pierścieniach pamięci współdzielonej są jeszcze przetwarzane
+    // Rozłączenie może od razu wywołać handleClientDisconnected, który zmienia m_clients
+    const QList<QTcpSocket*> clients = m_clients;
+    for (QTcpSocket *socket : clients) {
+        drainRing(socket, false);
+        releaseAssignments(socket);
+        dropVerifications(socket);
+        closeRing(socket);
+        removeConnectionMetrics(socket);
+    }
+    for (QTcpSocket *socket : clients) {
         socket->disconnectFromHost();
     }
 
     m_clients.clear();
     m_clientAddresses.clear();
+    m_clientTuning.clear();
+    m_pendingPrimes.clear();
+    m_connectedSlaves->set(0);
     ui->clientsListWidget->clear();
 
     m_server->close();
     m_serverRunning = false;
 
+    m_queryTasks.clear();
+    QMetaObject::invokeMethod(m_queryServer, [this]() {
+        m_queryServer->close();
+    }, Qt::BlockingQueuedConnection);
+
     ui->startServerButton->setEnabled(true);
     ui->stopServerButton->setEnabled(false);
     ui->distributeButton->setEnabled(false);
     ui->portSpinBox->setEnabled(true);
+    ui->queryPortSpinBox->setEnabled(true);
+
+    m_uiUpdater->invalidate(JobTableView);
 
     log("Server stopped");
     ui->statusLabel->setText("Server not running");
 }
 
 /**
- * Obsługuje kliknięcie przycisku dystrybucji zadań.
- * Pobiera zakres poszukiwania liczb pierwszych, dzieli go na części i przydziela każdemu podłączonemu klientowi.
- * Waliduje wprowadzone wartości zakresu i sprawdza dostępność klientów.
- * Dla każdego klienta oblicza indywidualny podzakres i wysyła zadanie przez TCP.
+ * Zwraca port, na którym nasłuchuje serwer (0 jeśli serwer nie działa).
  */
-void MasterWidget::on_distributeButton_clicked()
+quint16 MasterWidget::serverPort() const
+{
+    return m_server->serverPort();
+}
+
+/**
+ * Zwraca opis ostatniego błędu serwera TCP.
+ */
+QString MasterWidget::serverError() const
 {
+    return m_server->errorString();
+}
 
+/**
+ * Zwraca liczbę liczb pierwszych odebranych od slave'ów we wszystkich zadaniach.
+ */
+int MasterWidget::primeCount() const
+{
+    quint64 count = 0;
+    for (auto it = m_results.constBegin(); it != m_results.constEnd(); ++it) {
+        count += receivedPrimes(it.key());
+    }
+    return static_cast<int>(count);
+}
 
-    if (m_clients.isEmpty()) {
-        QMessageBox::warning(this, "Warning", "No connected slaves to distribute work");
-        return;
+/**
+ * Zwraca liczbę liczb pierwszych zadania odebranych od slave'ów: z zakończonych fragmentów
+ * i z fragmentów, na których podsumowanie master jeszcze czeka.
+ * @param jobId Identyfikator zadania
+ */
+quint64 MasterWidget::receivedPrimes(quint32 jobId) const
+{
+    quint64 count = m_results.value(jobId).segmentPrimes;
+    for (auto it = m_pendingPrimes.constBegin(); it != m_pendingPrimes.constEnd(); ++it) {
+        if (it.key().second == jobId) count += static_cast<quint64>(it->size());
     }
+    return count;
+}
 
+/**
+ * Zbiera liczby pierwsze zadania do wyświetlenia: najpierw zakończone fragmenty w kolejności
+ * ich zakończenia, potem liczby fragmentów w toku w kolejności odebrania.
+ * @param jobId Identyfikator zadania
+ */
+QVector<quint64> MasterWidget::jobPrimes(quint32 jobId) const
+{
+    QVector<quint64> primes;
+    primes.reserve(static_cast<int>(receivedPrimes(jobId)));
+
+    for (const QVector<quint64> &segment : m_results.value(jobId).segments) {
+        primes += segment;
+    }
+    for (auto it = m_pendingPrimes.constBegin(); it != m_pendingPrimes.constEnd(); ++it) {
+        if (it.key().second == jobId) primes += *it;
+    }
+    return primes;
+}
+
+/**
+ * Obsługuje kliknięcie przycisku dodania zadania.
+ * Waliduje zakres wprowadzony w interfejsie i dodaje zadanie wybranego typu i priorytetu do kolejki.
+ * Zadanie dodane, gdy nie ma podłączonych slave'ów, czeka w kolejce na pierwsze połączenie.
+ */
+void MasterWidget::on_distributeButton_clicked()
+{
     bool ok;
-    m_rangeStart = ui->rangeStartEdit->text().toULongLong(&ok);
+    quint64 start = ui->rangeStartEdit->text().toULongLong(&ok);
     if (!ok) {
         QMessageBox::warning(this, "Warning", "Invalid range start value");
         return;
     }
 
-    m_rangeEnd = ui->rangeEndEdit->text().toULongLong(&ok);
+    quint64 end = ui->rangeEndEdit->text().toULongLong(&ok);
     if (!ok) {
         QMessageBox::warning(this, "Warning", "Invalid range end value");
         return;
     }
 
-    if (m_rangeStart >= m_rangeEnd) {
+    if (start >= end) {
         QMessageBox::warning(this, "Warning", "Range start must be less than range end");
         return;
     }
 
+    JobType type = ui->jobTypeComboBox->currentIndex() == 1 ? JobType::Statistics : JobType::Primes;
+    JobPriority priority = static_cast<JobPriority>(ui->priorityComboBox->currentIndex());
+    quint32 modulus = static_cast<quint32>(ui->modulusSpinBox->value());
 
-    // Obliczanie zakresu dla każdego slave'a
-    quint64 totalRange = m_rangeEnd - m_rangeStart + 1;
-    quint64 rangePerClient = totalRange / m_clients.size();
+    quint32 jobId = addJob(type, priority, start, end, modulus);
+    if (m_clients.isEmpty()) {
+        log(QString("Job %1 is queued until a slave connects").arg(jobId));
+    }
+}
 
-    log(QString("Distributing work range [%1-%2] to %3 slaves").arg(m_rangeStart).arg(m_rangeEnd).arg(m_clients.size()));
+/**
+ * Dodaje zadanie do kolejki i od razu przydziela jego fragmenty wolnym slave'om.
+ * Nowe zadanie staje się zadaniem pokazywanym na liście liczb pierwszych.
+ * @param type Typ zadania
+ * @param priority Priorytet zadania
+ * @param start Początek zakresu
+ * @param end Koniec zakresu
+ * @param modulus Moduł rozkładu reszt (zadania statystyk)
+ * @return Identyfikator zadania
+ */
+quint32 MasterWidget::addJob(JobType type, JobPriority priority, quint64 start, quint64 end, quint32 modulus)
+{
+    quint32 jobId = m_scheduler.addJob(type, priority, start, end, modulus);
+    m_results.insert(jobId, JobResults());
 
-    // Czyszczenie listy znalezionych liczb pierwszych
-    m_primes.clear();
-    ui->primesListWidget->clear();
+    log(QString("Job %1 added: %2 [%3-%4], priority %5")
+            .arg(jobId).arg(jobTypeName(type)).arg(start).arg(end).arg(priorityName(priority)));
 
-    for (int i = 0; i < m_clients.size(); i++) {
-        QTcpSocket *client = m_clients[i];
+    m_selectedJob = jobId;
+    m_uiUpdater->invalidate(JobTableView);
+    updatePrimesList();
+    m_uiUpdater->invalidate(PrimeCountView);
 
-        quint64 start = m_rangeStart + i * rangePerClient;
-        quint64 end = (i == m_clients.size() - 1) ? m_rangeEnd : start + rangePerClient - 1;
+    dispatchTasks();
+    return jobId;
+}
 
-        // Tworzenie pakietu danych
-        QByteArray data;
-        QDataStream stream(&data, QIODevice::WriteOnly);
-        stream << quint8(1) << start << end; // 1 = kod operacji dla rozpoczęcia obliczeń
+/**
+ * Przydziela slave'om kolejne fragmenty zadań, aż każdy ma kTasksPerSlave fragmentów w toku.
+ * Slave'y dostają fragmenty po kolei, po jednym na obieg, a o tym, z którego zadania pochodzi
+ * fragment, decyduje JobScheduler według priorytetów zadań.
+ */
+void MasterWidget::dispatchTasks()
+{
+    QMap<QTcpSocket*, int> inFlight;
+    for (const Assignment &assignment : m_assignments) {
+        inFlight[assignment.socket]++;
+    }
 
-        // Wysyłanie zadania do slave'a
-        client->write(data);
+    bool assigned = true;
+    while (assigned) {
+        assigned = false;
+        for (QTcpSocket *client : m_clients) {
+            if (inFlight.value(client) >= kTasksPerSlave) continue;
+
+            JobTask task;
+            if (!m_scheduler.nextTask(&task)) {
+                m_uiUpdater->invalidate(JobTableView);
+                return;
+            }
+            const Job *job = m_scheduler.job(task.jobId);
+
+            QByteArray data;
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream << quint8(1) << task.jobId << static_cast<quint8>(job->type)
+                   << task.start << task.end << job->modulus; // 1 = kod operacji dla fragmentu zadania
+
+            client->write(data);
+
+            const ConnectionMetrics &metrics = m_connectionMetrics[client];
+            metrics.framesSent->add();
+            metrics.bytesSent->add(data.size());
+
+            Assignment assignment;
+            assignment.task = task;
+            assignment.socket = client;
+            assignment.remaining = {qMakePair(task.start, task.end)};
+            assignment.dispatched.start();
+            m_assignments.append(assignment);
+
+            inFlight[client]++;
+            assigned = true;
+        }
+    }
 
-        log(QString("Sent range [%1-%2] to slave %3").arg(start).arg(end).arg(m_clientAddresses[client]));
+    m_uiUpdater->invalidate(JobTableView);
+}
+
+/**
+ * Zwalnia fragmenty przydzielone slave'owi (rozłączenie lub zatrzymanie serwera).
+ * Części fragmentów bez wyników wracają do kolejki zadań, a liczby pierwsze odebrane bez
+ * podsumowania fragmentu są usuwane z wyników - ich zakres zostanie policzony ponownie.
+ * @param clientSocket Połączenie ze slave'em
+ */
+void MasterWidget::releaseAssignments(QTcpSocket *clientSocket)
+{
+    QList<quint32> jobIds;
+    for (int i = m_assignments.size() - 1; i >= 0; i--) {
+        if (m_assignments[i].socket != clientSocket) continue;
+
+        m_scheduler.taskFinished(m_assignments[i].task, m_assignments[i].remaining);
+        jobIds.append(m_assignments[i].task.jobId);
+        m_assignments.removeAt(i);
+    }
+
+    // Anulowane zadanie kończy się, gdy zwolniony fragment był ostatnim w toku
+    for (quint32 jobId : jobIds) {
+        finishJob(jobId);
+    }
+
+    for (auto it = m_pendingPrimes.begin(); it != m_pendingPrimes.end();) {
+        if (it.key().first != clientSocket) {
+            ++it;
+            continue;
+        }
+
+        // Liczby bez podsumowania fragmentu istnieją tylko w m_pendingPrimes
+        const quint32 jobId = it.key().second;
+        const int orphans = it->size();
+        it = m_pendingPrimes.erase(it);
+
+        if (orphans > 0 && m_results.contains(jobId)) {
+            log(QString("Discarded %1 primes of job %2 from %3 without a chunk summary, their range is queued again")
+                    .arg(orphans).arg(jobId).arg(m_clientAddresses.value(clientSocket)));
+            if (jobId == m_selectedJob) {
+                updatePrimesList();
+                m_uiUpdater->invalidate(PrimeCountView);
+            }
+        }
     }
 }
 
+/**
+ * Odejmuje zakres otrzymanego wyniku od fragmentu przydzielonego slave'owi. Slave dzieli
+ * fragment między swoje wątki i odsyła wyniki częściami; fragment jest zakończony, gdy
+ * nadejdą wszystkie części. Zakończenie fragmentu zwalnia miejsce na kolejny.
+ * @param clientSocket Połączenie, od którego przyszedł wynik
+ * @param jobId Identyfikator zadania
+ * @param summary Podsumowanie części fragmentu
+ */
+void MasterWidget::completeAssignment(QTcpSocket *clientSocket, quint32 jobId, const ChunkSummary &summary)
+{
+    if (summary.isEmpty())
+        return;
+
+    const PrimeRange received = qMakePair(summary.start, summary.end);
+    for (int i = 0; i < m_assignments.size(); i++) {
+        Assignment &assignment = m_assignments[i];
+        if (assignment.socket != clientSocket || assignment.task.jobId != jobId) continue;
+        if (received.second < assignment.task.start || received.first > assignment.task.end) continue;
+
+        assignment.remaining = subtractRange(assignment.remaining, received);
+        if (!assignment.remaining.isEmpty())
+            return;
+
+        m_chunkLatency->observe(static_cast<quint64>(assignment.dispatched.elapsed()));
+        m_scheduler.taskFinished(assignment.task, {});
+        m_assignments.removeAt(i);
+        if (jobId == m_selectedJob) m_uiUpdater->invalidate(PrimeCountView);
+
+        finishJob(jobId);
+        dispatchTasks();
+        return;
+    }
+}
+
+/**
+ * Sprawdza, czy zakres wyniku należy do nierozliczonej części fragmentu przydzielonego
+ * temu połączeniu. Wyniki spoza przydziałów (np. zadań zatrzymanych lub przydzielonych
+ * przed ponownym połączeniem slave'a) są odrzucane.
+ * @param clientSocket Połączenie, od którego przyszedł wynik
+ * @param jobId Identyfikator zadania
+ * @param start Początek zakresu wyniku
+ * @param end Koniec zakresu wyniku
+ */
+bool MasterWidget::isAssigned(QTcpSocket *clientSocket, quint32 jobId, quint64 start, quint64 end) const
+{
+    for (const Assignment &assignment : m_assignments) {
+        if (assignment.socket != clientSocket || assignment.task.jobId != jobId) continue;
+        for (const PrimeRange &range : assignment.remaining) {
+            if (start <= range.second && end >= range.first)
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Obsługuje zakończenie zadania: zapisuje czas trwania w dzienniku, a dla zadania statystyk
+ * łączy statystyki fragmentów. Zadanie niezakończone lub już obsłużone jest pomijane.
+ * @param jobId Identyfikator zadania
+ */
+void MasterWidget::finishJob(quint32 jobId)
+{
+    const Job *job = m_scheduler.job(jobId);
+    if (!job || !job->isFinished() || !m_results.contains(jobId) || m_results[jobId].reported)
+        return;
+
+    m_results[jobId].reported = true;
+
+    log(QString("Job %1 %2 in %3 s")
+            .arg(jobId).arg(job->cancelled ? "cancelled" : "finished")
+            .arg(job->timer.elapsed() / 1000.0, 0, 'f', 1));
+
+    if (job->type == JobType::Statistics && !job->cancelled)
+        reportStatistics(jobId);
+
+    if (jobId == m_selectedJob)
+        m_uiUpdater->invalidate(PrimeCountView);
+}
+
+/**
+ * Odświeża tabelę zadań: typ, zakres, priorytet, postęp i stan każdego zadania.
+ * Zaznaczenie wiersza wybranego zadania jest przywracane bez wywoływania obsługi zmiany zaznaczenia.
+ */
+void MasterWidget::updateJobTable()
+{
+    const QList<quint32> ids = m_scheduler.jobIds();
+
+    QSignalBlocker blocker(ui->jobsTableWidget);
+    ui->jobsTableWidget->setRowCount(ids.size());
+
+    for (int row = 0; row < ids.size(); row++) {
+        const Job *job = m_scheduler.job(ids[row]);
+
+        QString state;
+        if (job->cancelled) {
+            state = job->running > 0 ? "Cancelling" : "Cancelled";
+        } else if (job->isFinished()) {
+            state = "Finished";
+        } else {
+            state = job->running > 0 ? "Running" : "Queued";
+        }
+
+        const QStringList columns = {
+            QString::number(job->id),
+            jobTypeName(job->type),
+            QString("%1-%2").arg(job->start).arg(job->end),
+            priorityName(job->priority),
+            QString("%1%").arg(job->progress() * 100.0, 0, 'f', 1),
+            state
+        };
+        for (int column = 0; column < columns.size(); column++) {
+            ui->jobsTableWidget->setItem(row, column, new QTableWidgetItem(columns[column]));
+        }
+
+        if (job->id == m_selectedJob) ui->jobsTableWidget->selectRow(row);
+    }
+}
+
+/**
+ * Obsługuje kliknięcie przycisku anulowania wybranego zadania.
+ * Nieprzydzielone fragmenty nie zostaną wysłane, a fragmenty w trakcie obliczeń kończą się normalnie.
+ */
+void MasterWidget::on_cancelJobButton_clicked()
+{
+    const Job *job = m_scheduler.job(m_selectedJob);
+    if (!job || job->isFinished())
+        return;
+
+    m_scheduler.cancelJob(m_selectedJob);
+    log(QString("Job %1 cancelled").arg(m_selectedJob));
+
+    finishJob(m_selectedJob);
+    m_uiUpdater->invalidate(JobTableView);
+}
+
+/**
+ * Obsługuje zmianę zaznaczenia w tabeli zadań - lista liczb pierwszych pokazuje wybrane zadanie.
+ */
+void MasterWidget::on_jobsTableWidget_itemSelectionChanged()
+{
+    const QList<QTableWidgetItem*> selected = ui->jobsTableWidget->selectedItems();
+    if (selected.isEmpty())
+        return;
+
+    m_selectedJob = ui->jobsTableWidget->item(selected.first()->row(), 0)->text().toUInt();
+    updatePrimesList();
+    m_uiUpdater->invalidate(PrimeCountView);
+}
+
 /**
  * Obsługuje nowe połączenie klienta z serwerem.
  * Pobiera kolejne oczekujące połączenie, łączy odpowiednie sygnały klienta z funkcjami obsługi,
@@ -173,8 +610,28 @@ void MasterWidget::handleNewConnection()
     m_clients.append(clientSocket);
     m_clientAddresses[clientSocket] = clientAddress;
 
-    updateClientList();
+    // Liczniki są przypisane do adresu połączenia i pozostają w rejestrze po rozłączeniu
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    const MetricLabels labels = {{"connection", clientAddress}};
+    ConnectionMetrics connectionMetrics;
+    connectionMetrics.framesReceived = metrics.counter("prime_master_frames_received_total",
+                                                       "Frames received from a slave connection", labels);
+    connectionMetrics.bytesReceived = metrics.counter("prime_master_bytes_received_total",
+                                                      "Bytes received from a slave connection", labels);
+    connectionMetrics.framesSent = metrics.counter("prime_master_frames_sent_total",
+                                                   "Frames sent to a slave connection", labels);
+    connectionMetrics.bytesSent = metrics.counter("prime_master_bytes_sent_total",
+                                                  "Bytes sent to a slave connection", labels);
+    connectionMetrics.backlog = metrics.gauge("prime_master_receive_backlog_bytes",
+                                              "Bytes buffered on a slave connection waiting to be processed", labels);
+    connectionMetrics.labels = labels;
+    m_connectionMetrics[clientSocket] = connectionMetrics;
+    m_connectedSlaves->set(m_clients.size());
+
+    m_uiUpdater->invalidate(ClientListView);
     log(QString("New client connected: %1").arg(clientAddress));
+
+    dispatchTasks();
 }
 
 /**
@@ -190,71 +647,624 @@ void MasterWidget::handleClientDisconnected()
     QString clientAddress = m_clientAddresses[clientSocket];
     log(QString("Client disconnected: %1").arg(clientAddress));
 
+    // Wyniki zapisane przez slave'a w pierścieniu przed rozłączeniem są jeszcze ważne
+    drainRing(clientSocket, false);
+    closeRing(clientSocket);
+
+    // Fragmenty zadań liczone przez rozłączonego slave'a wracają do kolejki
+    releaseAssignments(clientSocket);
+    dropVerifications(clientSocket);
+
     m_clients.removeOne(clientSocket);
     m_clientAddresses.remove(clientSocket);
+    m_clientTuning.remove(clientSocket);
+    removeConnectionMetrics(clientSocket);
+    m_connectedSlaves->set(m_clients.size());
     clientSocket->deleteLater();
 
-    updateClientList();
+    // Zakresy zapytań liczone przez rozłączonego slave'a muszą zostać zlecone ponownie
+    int lostTasks = 0;
+    for (int i = m_queryTasks.size() - 1; i >= 0; i--) {
+        if (m_queryTasks[i].socket == clientSocket) {
+            m_queryTasks.removeAt(i);
+            lostTasks++;
+        }
+    }
+    if (lostTasks > 0) {
+        QMetaObject::invokeMethod(m_queryServer, "resubmitPending", Qt::QueuedConnection);
+    }
+
+    m_uiUpdater->invalidate(ClientListView);
+    dispatchTasks();
 }
 
 /**
- * Przetwarza wyniki otrzymane od klientów (slave'ów).
- * Odczytuje dane z połączenia TCP i interpretuje je zgodnie z protokołem:
- * - kod operacji 1: znaleziona liczba pierwsza - dodaje ją do listy i aktualizuje interfejs
- * - kod operacji 2: zakończenie obliczeń - rejestruje informację o zakończeniu pracy klienta
+ * Przetwarza dane otrzymane od klientów (slave'ów) przez połączenie TCP.
  */
 void MasterWidget::processResults()
 {
     QTcpSocket *clientSocket = qobject_cast<QTcpSocket*>(sender());
     if (!clientSocket) return;
 
-    QDataStream stream(clientSocket);
+    const ConnectionMetrics metrics = m_connectionMetrics.value(clientSocket);
+    if (metrics.backlog) metrics.backlog->set(clientSocket->bytesAvailable());
 
-    while (clientSocket->bytesAvailable() >= sizeof(quint8)) {
-        quint8 opCode;
+    processFrames(clientSocket, clientSocket);
+}
+
+/**
+ * Przetwarza wyniki otrzymane od slave'a przez połączenie TCP lub z bloku pierścienia
+ * pamięci współdzielonej. Interpretuje ramki zgodnie z protokołem:
+ * - kod operacji 1: znaleziona liczba pierwsza zadania - dodaje ją do wyników zadania
+ * - kod operacji 2: zakończenie obliczeń części fragmentu zadania - sprawdza odebrane liczby z podsumowaniem slave'a
+ * - kod operacji 3: wynik weryfikacji - identyfikator zlecenia i przeliczony fragment, porównywany z zapisanym podsumowaniem
+ * - kod operacji 4: zakres policzony na potrzeby zapytania - zapisuje go w magazynie wyników
+ * - kod operacji 5: statystyki części fragmentu zadania statystyk - zapisuje je do połączenia z pozostałymi
+ * - kod operacji 6: konfiguracja hosta slave'a wybrana przez autotuner - pokazuje ją na liście klientów
+ * - kod operacji 7: propozycja transportu przez pamięć współdzieloną - otwiera pierścień slave'a
+ * - kod operacji 8: dzwonek - w pierścieniu slave'a są nowe bloki ramek
+ * Ramki 1, 2 i 5 zaczynają się od identyfikatora zadania; wyniki nieznanych zadań są pomijane.
+ * Ramki są odczytywane transakcyjnie, więc ramka podzielona między kolejne segmenty TCP
+ * (lub bloki pierścienia) zostaje w urządzeniu do nadejścia reszty danych.
+ * @param clientSocket Połączenie ze slave'em, od którego pochodzą ramki
+ * @param device Gniazdo slave'a lub bufor z zawartością bloku pierścienia
+ */
+void MasterWidget::processFrames(QTcpSocket *clientSocket, QIODevice *device)
+{
+    QDataStream stream(device);
+
+    const ConnectionMetrics metrics = m_connectionMetrics.value(clientSocket);
+
+    forever {
+        stream.startTransaction();
+
+        quint8 opCode = 0;
         stream >> opCode;
 
         if (opCode == 1) { // Znaleziona liczba pierwsza
-            if (clientSocket->bytesAvailable() < sizeof(quint64))
+            quint32 jobId;
+            quint64 prime;
+            stream >> jobId >> prime;
+            if (!stream.commitTransaction())
                 return;
 
-            quint64 prime;
-            stream >> prime;
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + sizeof(quint32) + sizeof(quint64));
+            }
+            m_primesIngested->add();
+
+            if (!isAssigned(clientSocket, jobId, prime, prime))
+                continue;
+
+            m_pendingPrimes[qMakePair(clientSocket, jobId)].append(prime);
+            if (jobId == m_selectedJob) {
+                updatePrimesList(prime);
+                m_uiUpdater->invalidate(PrimeCountView);
+            }
+
+        } else if (opCode == 2) { // Zakończenie części fragmentu zadania
+            quint32 jobId;
+            ChunkSummary summary;
+            stream >> jobId >> summary;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + sizeof(quint32) + ChunkSummary::SerializedSize);
+            }
+
+            if (summary.isEmpty() || !m_scheduler.job(jobId)
+                || !isAssigned(clientSocket, jobId, summary.start, summary.end))
+                continue;
+
+            recordChunk(clientSocket, jobId, summary);
+            emit slaveFinished(m_clientAddresses[clientSocket], summary.count);
+            completeAssignment(clientSocket, jobId, summary);
+
+        } else if (opCode == 3) { // Wynik weryfikacji
+            quint32 requestId;
+            ChunkSummary summary;
+            stream >> requestId >> summary;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + sizeof(quint32) + ChunkSummary::SerializedSize);
+            }
+
+            checkVerification(requestId, summary);
+
+        } else if (opCode == 4) { // Zakres policzony na potrzeby zapytania
+            ChunkSummary summary;
+            QByteArray encodedPrimes;
+            stream >> summary >> encodedPrimes;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + ChunkSummary::SerializedSize
+                                           + sizeof(quint32) + encodedPrimes.size());
+            }
+
+            storeQueryRange(clientSocket, summary, encodedPrimes);
+
+        } else if (opCode == 5) { // Statystyki części fragmentu zadania
+            quint32 jobId;
+            PrimeStats stats;
+            stream >> jobId >> stats;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + sizeof(quint32) + stats.serializedSize());
+            }
+
+            if (stats.summary.isEmpty() || !m_scheduler.job(jobId)
+                || !isAssigned(clientSocket, jobId, stats.summary.start, stats.summary.end))
+                continue;
+
+            recordStatistics(clientSocket, jobId, stats);
+            emit slaveFinished(m_clientAddresses[clientSocket], stats.summary.count);
+            completeAssignment(clientSocket, jobId, stats.summary);
+
+        } else if (opCode == 6) { // Konfiguracja hosta slave'a
+            TuningResult tuning;
+            stream >> tuning;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + tuning.serializedSize());
+            }
+
+            m_clientTuning[clientSocket] = tuning;
+            log(QString("Slave %1 (%2) tuned: %3, L1d %4 KiB, L2 %5 KiB, L3 %6 KiB")
+                    .arg(m_clientAddresses[clientSocket]).arg(tuning.host).arg(tuning.description())
+                    .arg(tuning.l1d / 1024).arg(tuning.l2 / 1024).arg(tuning.l3 / 1024));
+            m_uiUpdater->invalidate(ClientListView);
+
+        } else if (opCode == 7) { // Propozycja transportu przez pamięć współdzieloną
+            QString name;
+            stream >> name;
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8) + sizeof(quint32) + 2 * name.size());
+            }
+
+            // Ramki sterujące pierścieniem są przyjmowane tylko przez TCP
+            if (device != clientSocket)
+                continue;
+            attachRing(clientSocket, name);
+
+        } else if (opCode == 8) { // Dzwonek pierścienia
+            if (!stream.commitTransaction())
+                return;
+
+            if (metrics.framesReceived) {
+                metrics.framesReceived->add();
+                metrics.bytesReceived->add(sizeof(quint8));
+            }
+
+            if (device != clientSocket)
+                continue;
+            drainRing(clientSocket);
+
+        } else if (!stream.commitTransaction()) {
+            return;
+        }
+    }
+}
+
+/**
+ * Otwiera pierścień pamięci współdzielonej zaproponowany przez slave'a działającego na tym
+ * samym hoście i odpowiada, czy slave może przez niego wysyłać wyniki. Propozycja jest
+ * odrzucana, jeśli slave łączy się z innego hosta lub nazwa nie wskazuje segmentu pierścienia.
+ * Jeśli segmentu nie da się otworzyć (np. slave działa w innej przestrzeni nazw IPC), slave
+ * zostaje przy TCP.
+ * @param clientSocket Połączenie ze slave'em
+ * @param name Nazwa segmentu pamięci współdzielonej
+ */
+void MasterWidget::attachRing(QTcpSocket *clientSocket, const QString &name)
+{
+    bool attached = false;
+
+    if (!ShmRing::isLocalAddress(clientSocket->peerAddress())) {
+        log(QString("Rejected shared memory offer from remote slave %1").arg(m_clientAddresses[clientSocket]));
+    } else if (!ShmRing::isValidName(name)) {
+        log(QString("Rejected shared memory offer from slave %1: invalid segment name")
+                .arg(m_clientAddresses[clientSocket]));
+    } else {
+        ShmRing *ring = new ShmRing;
+        attached = ring->attach(name);
+
+        if (attached) {
+            closeRing(clientSocket);
+            m_rings.insert(clientSocket, ring);
+            log(QString("Slave %1 uses shared-memory transport (%2 KiB ring)")
+                    .arg(m_clientAddresses[clientSocket]).arg(ring->capacity() / 1024));
+        } else {
+            log(QString("Cannot attach shared memory of slave %1: %2, staying on TCP")
+                    .arg(m_clientAddresses[clientSocket]).arg(ring->errorString()));
+            delete ring;
+        }
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(5) << quint8(attached ? 1 : 0); // 5 = kod operacji odpowiedzi na propozycję pamięci współdzielonej
+
+    clientSocket->write(data);
 
-            m_primes.append(prime);
-            updatePrimesList(prime);
-            updatePrimeCount();
+    const ConnectionMetrics metrics = m_connectionMetrics.value(clientSocket);
+    if (metrics.framesSent) {
+        metrics.framesSent->add();
+        metrics.bytesSent->add(data.size());
+    }
+}
 
-        } else if (opCode == 2) { // Zakończenie obliczeń
-            if (clientSocket->bytesAvailable() < sizeof(quint32))
+/**
+ * Przetwarza wszystkie bloki z pierścienia slave'a. Ramki są dekodowane bezpośrednio
+ * z pamięci współdzielonej; kopiowana jest tylko ramka podzielona między bloki. Po opróżnieniu
+ * pierścienia master czeka na dzwonek, a bloki dopisane w międzyczasie przetwarza od razu.
+ * Uszkodzony pierścień jest zamykany, a połączenie ze slave'em zrywane.
+ * Po kMaxRingDrainBytes bajtów dalsze przetwarzanie jest odkładane do kolejnej iteracji pętli zdarzeń.
+ * Przed zamknięciem pierścienia (rozłączenie, zatrzymanie serwera) limit jest wyłączany, bo pierścień
+ * jest większy od kMaxRingDrainBytes, a odłożona reszta zostałaby utracona.
+ * @param clientSocket Połączenie ze slave'em, do którego należy pierścień
+ * @param limit Czy przerwać przetwarzanie po kMaxRingDrainBytes bajtów
+ */
+void MasterWidget::drainRing(QTcpSocket *clientSocket, bool limit)
+{
+    ShmRing *ring = m_rings.value(clientSocket);
+    if (!ring) return;
+
+    quint64 drained = 0;
+    do {
+        const char *data;
+        quint32 size;
+        ShmRing::ReadStatus status;
+        while ((status = ring->read(&data, &size)) == ShmRing::BlockReady) {
+            // Szybki slave mógłby zablokować pętlę zdarzeń; resztę bloków przetwarza kolejne wywołanie
+            if (limit && drained >= kMaxRingDrainBytes) {
+                QMetaObject::invokeMethod(this, [this, clientSocket]() {
+                    drainRing(clientSocket);
+                }, Qt::QueuedConnection);
                 return;
+            }
+            drained += size;
+
+            QByteArray pending = m_ringPending.take(clientSocket);
+            QByteArray block = pending.isEmpty() ? QByteArray::fromRawData(data, static_cast<int>(size))
+                                                 : pending.append(data, static_cast<int>(size));
+
+            QBuffer buffer(&block);
+            buffer.open(QIODevice::ReadOnly);
+            processFrames(clientSocket, &buffer);
+
+            // Niedokończona ramka jest kopiowana, zanim blok zostanie zwolniony dla slave'a
+            const int consumed = static_cast<int>(buffer.pos());
+            if (consumed < block.size())
+                m_ringPending.insert(clientSocket, QByteArray(block.constData() + consumed, block.size() - consumed));
+
+            ring->release();
+        }
+
+        if (status == ShmRing::Corrupted) {
+            // Połączenie jest zrywane poza bieżącym przetwarzaniem ramek tego gniazda
+            log(QString("Protocol error: corrupted shared-memory ring from slave %1, disconnecting it")
+                    .arg(m_clientAddresses[clientSocket]));
+            closeRing(clientSocket);
+            QMetaObject::invokeMethod(clientSocket, [clientSocket]() {
+                clientSocket->abort();
+            }, Qt::QueuedConnection);
+            return;
+        }
+    } while (!ring->park());
+}
+
+/**
+ * Zamyka pierścień slave'a (rozłączenie lub zatrzymanie serwera).
+ * @param clientSocket Połączenie ze slave'em
+ */
+void MasterWidget::closeRing(QTcpSocket *clientSocket)
+{
+    delete m_rings.take(clientSocket);
+    m_ringPending.remove(clientSocket);
+}
+
+/**
+ * Usuwa z rejestru serie metryk połączenia ze slave'em, aby rejestr nie rósł z każdym
+ * ponownym połączeniem. Sumaryczne liczniki mastera nie są usuwane.
+ * @param clientSocket Zamykane połączenie
+ */
+void MasterWidget::removeConnectionMetrics(QTcpSocket *clientSocket)
+{
+    if (!m_connectionMetrics.contains(clientSocket))
+        return;
+
+    MetricsRegistry::instance().remove(m_connectionMetrics.take(clientSocket).labels);
+}
+
+/**
+ * Zapisuje zakończony fragment i sprawdza, czy liczby pierwsze odebrane od slave'a
+ * z zakresu fragmentu zgadzają się z jego podsumowaniem (liczba, suma i skrót).
+ * Niezgodność oznacza utraconą lub zdublowaną liczbę pierwszą w transmisji.
+ * @param clientSocket Połączenie, od którego przyszło podsumowanie
+ * @param jobId Identyfikator zadania
+ * @param reported Podsumowanie fragmentu wyliczone przez slave'a
+ */
+void MasterWidget::recordChunk(QTcpSocket *clientSocket, quint32 jobId, const ChunkSummary &reported)
+{
+    if (!m_results.contains(jobId))
+        return;
+
+    ChunkSummary received;
+    received.start = reported.start;
+    received.end = reported.end;
+
+    // Liczby z zakresu fragmentu trafiają na koniec wektora i są z niego usuwane
+    QVector<quint64> &pending = m_pendingPrimes[qMakePair(clientSocket, jobId)];
+    auto inChunk = std::partition(pending.begin(), pending.end(), [&reported](quint64 prime) {
+        return prime < reported.start || prime > reported.end;
+    });
+    QVector<quint64> chunkPrimes;
+    chunkPrimes.reserve(static_cast<int>(pending.end() - inChunk));
+    for (auto it = inChunk; it != pending.end(); ++it) {
+        received.add(*it);
+        chunkPrimes.append(*it);
+    }
+    pending.erase(inChunk, pending.end());
+    std::sort(chunkPrimes.begin(), chunkPrimes.end());
+
+    ChunkRecord record;
+    record.summary = reported;
+    record.address = m_clientAddresses.value(clientSocket);
+    record.transferOk = received.sameResult(reported);
+
+    JobResults &results = m_results[jobId];
+    results.chunks.append(record);
+    results.segmentPrimes += static_cast<quint64>(chunkPrimes.size());
+    results.segments.append(chunkPrimes);
+
+    if (!record.transferOk) {
+        log(QString("Chunk [%1-%2] from %3: received %4 primes but slave reported %5 (checksum mismatch)")
+                .arg(reported.start).arg(reported.end).arg(record.address)
+                .arg(received.count).arg(reported.count));
+    } else if (!reported.isEmpty()) {
+        // Zgodny fragment trafia do magazynu serwera zapytań bez kopiowania - wektor jest
+        // współdzielony z wynikami zadania
+        m_store.insert(reported.start, reported.end, chunkPrimes, PrimeStore::Shared);
+        QMetaObject::invokeMethod(m_queryServer, "retryPending", Qt::QueuedConnection);
+    }
+}
+
+/**
+ * Zapisuje statystyki fragmentu zadania statystyk. Fragment trafia też do listy fragmentów
+ * używanej przez weryfikację (pokrycie zakresu i ponowne przeliczenie próbki), przy czym
+ * nie ma tu przesłanych liczb do porównania z sumą kontrolną.
+ * Statystyki są łączone i zapisywane w dzienniku po zakończeniu zadania (finishJob).
+ * @param clientSocket Połączenie, od którego przyszły statystyki
+ * @param jobId Identyfikator zadania
+ * @param stats Statystyki fragmentu
+ */
+void MasterWidget::recordStatistics(QTcpSocket *clientSocket, quint32 jobId, const PrimeStats &stats)
+{
+    if (!m_results.contains(jobId))
+        return;
 
-            quint32 count;
-            stream >> count;
+    JobResults &results = m_results[jobId];
 
-            log(QString("Slave %1 finished calculation, found %2 primes")
-                    .arg(m_clientAddresses[clientSocket]).arg(count));
+    ChunkRecord record;
+    record.summary = stats.summary;
+    record.address = m_clientAddresses.value(clientSocket);
+    record.transferOk = true;
+    results.chunks.append(record);
+
+    if (stats.summary.isEmpty())
+        return;
+
+    results.statsPieces.append(stats);
+}
+
+/**
+ * Łączy statystyki fragmentów zadania w kolejności zakresów (razem z parami i lukami na granicach
+ * fragmentów) i zapisuje wynik w dzienniku: liczby par, największą lukę, luki maksymalne
+ * (pierwsze wystąpienia luk większych od wszystkich wcześniejszych) i rozkład reszt.
+ * @param jobId Identyfikator zadania
+ */
+void MasterWidget::reportStatistics(quint32 jobId)
+{
+    QList<PrimeStats> pieces = m_results.value(jobId).statsPieces;
+    if (pieces.isEmpty())
+        return;
+
+    std::sort(pieces.begin(), pieces.end(), [](const PrimeStats &a, const PrimeStats &b) {
+        return a.summary.start < b.summary.start;
+    });
+
+    PrimeStats total = pieces.first();
+    for (int i = 1; i < pieces.size(); i++) {
+        if (!total.merge(pieces[i])) {
+            log(QString("Statistics: chunk [%1-%2] does not follow the previous chunk, boundary pairs are skipped")
+                    .arg(pieces[i].summary.start).arg(pieces[i].summary.end));
+        }
+    }
+
+    log(QString("Job %1 statistics [%2-%3]: %4 primes, %5 twin pairs, %6 cousin pairs, %7 sexy pairs")
+            .arg(jobId).arg(total.summary.start).arg(total.summary.end).arg(total.summary.count)
+            .arg(total.twins).arg(total.cousins).arg(total.sexy));
+    QPair<quint32, quint64> maxGap = total.maxGap();
+    if (maxGap.first > 0) {
+        log(QString("Largest gap: %1 after %2").arg(maxGap.first).arg(maxGap.second));
+    }
+
+    // Luki maksymalne: kolejne pierwsze wystąpienia uporządkowane według miejsca wystąpienia
+    QMap<quint64, quint32> byPosition;
+    for (auto it = total.firstGap.constBegin(); it != total.firstGap.constEnd(); ++it) {
+        byPosition.insert(it.value(), it.key());
+    }
+    QStringList records;
+    quint32 largest = 0;
+    for (auto it = byPosition.constBegin(); it != byPosition.constEnd(); ++it) {
+        if (it.value() > largest) {
+            largest = it.value();
+            records << QString("%1@%2").arg(it.value()).arg(it.key());
+        }
+    }
+    if (!records.isEmpty()) {
+        log("Maximal gaps (gap@prime): " + records.join(", "));
+    }
+
+    QStringList residues;
+    for (int r = 0; r < total.residues.size(); r++) {
+        if (total.residues[r] > 0) residues << QString("%1:%2").arg(r).arg(total.residues[r]);
+    }
+    log(QString("Residues mod %1 (residue:count): %2").arg(total.modulus).arg(residues.join(" ")));
+}
+
+/**
+ * Zleca slave'om obliczenie zakresu potrzebnego serwerowi zapytań.
+ * Pomija części już zapisane w magazynie lub właśnie liczone, a pozostałe dzieli między slave'y.
+ * @param start Początek zakresu
+ * @param end Koniec zakresu
+ */
+void MasterWidget::dispatchQueryRange(quint64 start, quint64 end)
+{
+    QVector<PrimeRange> ranges = m_store.missing(start, end);
+    for (const QueryTask &task : m_queryTasks) {
+        ranges = subtractRange(ranges, task.range);
+    }
+    if (ranges.isEmpty())
+        return;
+
+    if (m_clients.isEmpty()) {
+        QMetaObject::invokeMethod(m_queryServer, "failPending", Qt::QueuedConnection,
+                                  Q_ARG(QString, "No slaves connected to compute the missing range"));
+        return;
+    }
+
+    for (const PrimeRange &range : ranges) {
+        quint64 size = range.second - range.first + 1;
+        quint64 pieces = qBound<quint64>(1, size / kMinQueryPiece, m_clients.size());
+        quint64 rangePerPiece = size / pieces;
+
+        for (quint64 i = 0; i < pieces; i++) {
+            quint64 pieceStart = range.first + i * rangePerPiece;
+            quint64 pieceEnd = (i == pieces - 1) ? range.second : pieceStart + rangePerPiece - 1;
+
+            QTcpSocket *client = m_clients[m_nextQueryClient++ % m_clients.size()];
+
+            QByteArray data;
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream << quint8(4) << pieceStart << pieceEnd; // 4 = kod operacji dla zakresu zapytania
+
+            client->write(data);
+
+            const ConnectionMetrics &metrics = m_connectionMetrics[client];
+            metrics.framesSent->add();
+            metrics.bytesSent->add(data.size());
+
+            QueryTask task;
+            task.range = qMakePair(pieceStart, pieceEnd);
+            task.socket = client;
+            m_queryTasks.append(task);
         }
+
+        log(QString("Query needs range [%1-%2], sent to slaves").arg(range.first).arg(range.second));
     }
 }
 
+/**
+ * Zapisuje w magazynie zakres policzony przez slave'a na potrzeby zapytania.
+ * Lista jest sprawdzana z podsumowaniem slave'a (kolejność, zakres, liczba, suma i skrót);
+ * uszkodzony zakres nie jest zapisywany, a oczekujące zapytania zlecają go ponownie.
+ * @param clientSocket Połączenie, od którego przyszedł wynik
+ * @param summary Podsumowanie zakresu
+ * @param encodedPrimes Liczby pierwsze zakodowane przez encodePrimes
+ */
+void MasterWidget::storeQueryRange(QTcpSocket *clientSocket, const ChunkSummary &summary,
+                                   const QByteArray &encodedPrimes)
+{
+    if (summary.isEmpty())
+        return;
+
+    // Zakres przestaje być liczony niezależnie od tego, czy wynik jest poprawny
+    const PrimeRange received = qMakePair(summary.start, summary.end);
+    QList<QueryTask> remaining;
+    for (const QueryTask &task : m_queryTasks) {
+        if (task.socket != clientSocket) {
+            remaining.append(task);
+            continue;
+        }
+        for (const PrimeRange &range : subtractRange({task.range}, received)) {
+            QueryTask rest;
+            rest.range = range;
+            rest.socket = clientSocket;
+            remaining.append(rest);
+        }
+    }
+    m_queryTasks = remaining;
+
+    QVector<quint64> primes;
+    bool valid = decodePrimes(encodedPrimes, &primes);
+
+    ChunkSummary decoded;
+    decoded.start = summary.start;
+    decoded.end = summary.end;
+    for (int i = 0; i < primes.size() && valid; i++) {
+        if (primes[i] < summary.start || primes[i] > summary.end || (i > 0 && primes[i] <= primes[i - 1]))
+            valid = false;
+        decoded.add(primes[i]);
+    }
+
+    if (!valid || !decoded.sameResult(summary)) {
+        log(QString("Query range [%1-%2] from %3 does not match its checksum, requesting it again")
+                .arg(summary.start).arg(summary.end).arg(m_clientAddresses.value(clientSocket)));
+        QMetaObject::invokeMethod(m_queryServer, "resubmitPending", Qt::QueuedConnection);
+        return;
+    }
+
+    m_store.insert(summary.start, summary.end, primes);
+    QMetaObject::invokeMethod(m_queryServer, "retryPending", Qt::QueuedConnection);
+}
+
 /**
  * Aktualizuje etykietę z liczbą znalezionych liczb pierwszych.
  * Wyświetla aktualną liczbę znalezionych liczb pierwszych na interfejsie.
  */
 void MasterWidget::updatePrimeCount()
 {
-    ui->primeCountLabel->setText(QString("Found: %1").arg(m_primes.count()));
+    const Job *job = m_scheduler.job(m_selectedJob);
+    if (job && job->type == JobType::Statistics) {
+        ui->primeCountLabel->setText(QString("Statistics: %1% done").arg(job->progress() * 100.0, 0, 'f', 1));
+        return;
+    }
+
+    ui->primeCountLabel->setText(QString("Found: %1").arg(receivedPrimes(m_selectedJob)));
 }
 
 /**
  * Aktualizuje listę podłączonych klientów na interfejsie użytkownika.
- * Czyści obecną listę i wypełnia ją aktualnymi adresami klientów.
+ * Czyści obecną listę i wypełnia ją aktualnymi adresami klientów oraz zgłoszoną konfiguracją hostów.
  */
 void MasterWidget::updateClientList()
 {
     ui->clientsListWidget->clear();
-    for (const QString &client : m_clientAddresses.values()) {
+    for (auto it = m_clientAddresses.constBegin(); it != m_clientAddresses.constEnd(); ++it) {
+        QString client = it.value();
+        if (m_clientTuning.contains(it.key())) {
+            const TuningResult tuning = m_clientTuning.value(it.key());
+            client += QString(" - %1, %2 threads").arg(tuning.host).arg(tuning.threads);
+        }
 
         ui->clientsListWidget->addItem(client);
 
@@ -263,13 +1273,20 @@ void MasterWidget::updateClientList()
 
 /**
  * Aktualizuje pełną listę znalezionych liczb pierwszych na interfejsie użytkownika.
- * Czyści obecną listę i wypełnia ją wszystkimi znalezionymi liczbami pierwszymi.
+ * Czyści obecną listę i wypełnia ją liczbami pierwszymi wybranego zadania.
  */
 void MasterWidget::updatePrimesList()
 {
+    m_listAppends.clear();
     ui->primesListWidget->clear();
 
-    for (const quint64 &prime : m_primes) {
+    QVector<quint64> primes = jobPrimes(m_selectedJob);
+    if (m_primesSorted && m_sortAscending) {
+        std::sort(primes.begin(), primes.end());
+    } else if (m_primesSorted) {
+        std::sort(primes.begin(), primes.end(), std::greater<quint64>());
+    }
+    for (const quint64 &prime : primes) {
 
         ui->primesListWidget->addItem(QString::number(prime));
 
@@ -277,50 +1294,299 @@ void MasterWidget::updatePrimesList()
 }
 
 /**
- * Dodaje pojedynczą liczbę pierwszą do listy na interfejsie użytkownika.
+ * Zapamiętuje liczbę pierwszą do dopisania do listy na interfejsie użytkownika.
+ * Liczby są dopisywane zbiorczo przy najbliższym odświeżeniu widoków.
  * @param prime Liczba pierwsza do dodania
  */
 void MasterWidget::updatePrimesList(quint64 prime)
 {
-    ui->primesListWidget->addItem(QString::number(prime));
+    m_listAppends.append(prime);
+    m_uiUpdater->invalidate(PrimesListView);
+}
+
+/**
+ * Dopisuje do listy liczby pierwsze zebrane od ostatniego odświeżenia jedną operacją.
+ */
+void MasterWidget::appendPrimesList()
+{
+    QStringList items;
+    items.reserve(m_listAppends.size());
+    for (quint64 prime : m_listAppends) {
+        items.append(QString::number(prime));
+    }
+    m_listAppends.clear();
+
+    ui->primesListWidget->addItems(items);
 }
 
 /**
  * Dodaje wiadomość do dziennika logów.
- * Dołącza znacznik czasu do wiadomości i wyświetla ją w polu tekstowym logów.
+ * Wiadomość ze znacznikiem czasu trafia do pola tekstowego przy najbliższym odświeżeniu interfejsu.
  * @param message Treść wiadomości do zalogowania
  */
 void MasterWidget::log(const QString &message)
 {
-
-    ui->logTextEdit->append(QTime::currentTime().toString("[HH:mm:ss] ") + message);
-
+    m_uiUpdater->log(message);
 }
 
 /**
  * Obsługuje kliknięcie przycisku weryfikacji wyników.
- * Oblicza przybliżoną liczbę liczb pierwszych w zadanym zakresie na podstawie twierdzenia
- * o liczbach pierwszych, porównuje z faktycznie znalezioną liczbą i wyświetla różnicę.
+ * Sprawdza dokładnie, czy zakończone fragmenty pokrywają cały zakres bez luk i nakładania się
+ * oraz czy liczby odebrane od slave'ów zgadzają się z ich sumami kontrolnymi. Dodatkowo
+ * podaje przybliżenie z twierdzenia o liczbach pierwszych i zleca ponowne przeliczenie
+ * losowej próbki fragmentów na innych slave'ach (wyniki trafiają do dziennika).
  */
 void MasterWidget::on_verifyButton_clicked()
 {
-    double approximation = primeCountApproximation(m_rangeEnd) - primeCountApproximation(m_rangeStart - 1);
+    const Job *job = m_scheduler.job(m_selectedJob);
+    if (!job) {
+        QMessageBox::information(this, "Verification Results", "Brak zadania do weryfikacji");
+        return;
+    }
+    const JobResults &results = m_results[m_selectedJob];
 
-    double difference = std::abs(m_primes.count() - approximation) / approximation * 100.0;
+    double approximation = primeCountApproximation(job->end)
+                           - (job->start > 0 ? primeCountApproximation(job->start - 1) : 0);
 
-    QString message = QString("Znalezione liczby pierwsze: %1\n"
-                              "Aproksymacja matematyczna: %2\n"
-                              "Różnica: %3%")
-                          .arg(m_primes.count())
+    // Zadanie statystyk nie przesyła liczb pierwszych - liczba pochodzi z podsumowań fragmentów
+    quint64 found = receivedPrimes(m_selectedJob);
+    if (job->type == JobType::Statistics) {
+        found = 0;
+        for (const ChunkRecord &record : results.chunks) {
+            if (!record.summary.isEmpty()) found += record.summary.count;
+        }
+    }
+
+    double difference = std::abs(found - approximation) / approximation * 100.0;
+
+    QStringList problems = checkCoverage(m_selectedJob);
+
+    QString message = QString("Zadanie: %1\n"
+                              "Znalezione liczby pierwsze: %2\n"
+                              "Aproksymacja matematyczna: %3\n"
+                              "Różnica: %4%\n\n"
+                              "Fragmenty: %5\n")
+                          .arg(m_selectedJob)
+                          .arg(found)
                           .arg(approximation, 0, 'f', 2)
-                          .arg(difference, 0, 'f', 2);
+                          .arg(difference, 0, 'f', 2)
+                          .arg(results.chunks.size());
+
+    if (problems.isEmpty()) {
+        message += "Pokrycie zakresu i sumy kontrolne: OK";
+    } else {
+        message += "Wykryte problemy:\n" + QStringList(problems.mid(0, 10)).join('\n');
+        if (problems.size() > 10)
+            message += QString("\n... i %1 więcej").arg(problems.size() - 10);
+    }
 
     QMessageBox::information(this, "Verification Results", message);
 
-    log(QString("Verification: Found %1 primes, approximation: %2, difference: %3%")
-            .arg(m_primes.count())
+    log(QString("Verification of job %1: Found %2 primes, approximation: %3, difference: %4%")
+            .arg(m_selectedJob)
+            .arg(found)
             .arg(approximation, 0, 'f', 2)
             .arg(difference, 0, 'f', 2));
+    for (const QString &problem : problems) {
+        log("Verification problem: " + problem);
+    }
+
+    startSampledVerification(m_selectedJob);
+}
+
+/**
+ * Sprawdza pokrycie zakresu zadania przez zakończone fragmenty oraz zgodność przesłanych wyników.
+ * @param jobId Identyfikator zadania
+ * @return Lista opisów wykrytych problemów (pusta, jeśli wyniki są kompletne i spójne)
+ */
+QStringList MasterWidget::checkCoverage(quint32 jobId) const
+{
+    QStringList problems;
+
+    const Job *job = m_scheduler.job(jobId);
+    if (!job)
+        return problems;
+    const JobResults results = m_results.value(jobId);
+
+    QList<ChunkSummary> chunks;
+    quint64 reportedTotal = 0;
+    for (const ChunkRecord &record : results.chunks) {
+        if (!record.transferOk) {
+            problems << QString("chunk [%1-%2] from %3 does not match its checksum")
+                            .arg(record.summary.start).arg(record.summary.end).arg(record.address);
+        }
+        if (!record.summary.isEmpty()) {
+            chunks.append(record.summary);
+            reportedTotal += record.summary.count;
+        }
+    }
+
+    std::sort(chunks.begin(), chunks.end(), [](const ChunkSummary &a, const ChunkSummary &b) {
+        return a.start < b.start;
+    });
+
+    // Kolejny oczekiwany początek fragmentu; luki i nakładania są wykrywane względem niego
+    quint64 expected = job->start;
+    for (const ChunkSummary &chunk : chunks) {
+        if (chunk.start > expected) {
+            problems << QString("range [%1-%2] was not computed").arg(expected).arg(chunk.start - 1);
+        } else if (chunk.start < expected) {
+            problems << QString("range [%1-%2] was computed more than once")
+                            .arg(chunk.start).arg(qMin(expected - 1, chunk.end));
+        }
+        expected = qMax(expected, chunk.end + 1);
+    }
+    if (expected <= job->end) {
+        problems << QString("range [%1-%2] was not computed").arg(expected).arg(job->end);
+    }
+
+    int pending = 0;
+    for (auto it = m_pendingPrimes.constBegin(); it != m_pendingPrimes.constEnd(); ++it) {
+        if (it.key().second == jobId) pending += it->size();
+    }
+    if (pending > 0) {
+        problems << QString("%1 primes were received outside any finished chunk").arg(pending);
+    }
+
+    if (job->type == JobType::Primes && reportedTotal != receivedPrimes(jobId)) {
+        problems << QString("slaves reported %1 primes but %2 were received")
+                        .arg(reportedTotal).arg(receivedPrimes(jobId));
+    }
+
+    return problems;
+}
+
+/**
+ * Zleca ponowne przeliczenie losowej próbki fragmentów w trybie samego zliczania.
+ * Każdy fragment trafia do innego slave'a niż ten, który go policzył (jeśli jest dostępny).
+ * Wielkość próbki (procent fragmentów) pochodzi z interfejsu użytkownika.
+ * @param jobId Identyfikator zadania
+ */
+void MasterWidget::startSampledVerification(quint32 jobId)
+{
+    const QList<ChunkRecord> chunks = m_results.value(jobId).chunks;
+
+    int percent = ui->verifySampleSpinBox->value();
+    if (percent == 0 || chunks.isEmpty() || m_clients.isEmpty())
+        return;
+
+    QVector<int> indices;
+    for (int i = 0; i < chunks.size(); i++) {
+        if (!chunks[i].summary.isEmpty()) indices.append(i);
+    }
+    std::shuffle(indices.begin(), indices.end(), *QRandomGenerator::global());
+
+    int sampleSize = qMin(indices.size(), qMax(1, (chunks.size() * percent + 99) / 100));
+
+    m_pendingVerifications.clear();
+    m_verifyConfirmed = 0;
+    m_verifyFailed = 0;
+    m_verifyLost = 0;
+
+    for (int n = 0; n < sampleSize; n++) {
+        const ChunkRecord &record = chunks[indices[n]];
+
+        QList<QTcpSocket*> candidates;
+        for (QTcpSocket *client : m_clients) {
+            if (m_clientAddresses.value(client) != record.address) candidates.append(client);
+        }
+        if (candidates.isEmpty()) {
+            candidates = m_clients;
+            log(QString("No other slave available, chunk [%1-%2] is re-verified by the same slave")
+                    .arg(record.summary.start).arg(record.summary.end));
+        }
+        QTcpSocket *client = candidates[n % candidates.size()];
+
+        const quint32 requestId = ++m_nextVerificationId;
+
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << quint8(3) << requestId << record.summary.start << record.summary.end; // 3 = kod operacji weryfikacji
+
+        client->write(data);
+
+        const ConnectionMetrics &metrics = m_connectionMetrics[client];
+        metrics.framesSent->add();
+        metrics.bytesSent->add(data.size());
+
+        PendingVerification pending;
+        pending.jobId = jobId;
+        pending.chunk = indices[n];
+        pending.socket = client;
+        m_pendingVerifications.insert(requestId, pending);
+    }
+
+    log(QString("Re-verifying %1 of %2 chunks on other slaves").arg(sampleSize).arg(chunks.size()));
+}
+
+/**
+ * Porównuje wynik ponownego przeliczenia fragmentu z podsumowaniem zapisanym przy jego zakończeniu.
+ * Po otrzymaniu wszystkich wyników próbki zapisuje w dzienniku podsumowanie weryfikacji.
+ * @param requestId Identyfikator zlecenia weryfikacji wysłany razem z zakresem
+ * @param recomputed Podsumowanie fragmentu przeliczonego przez innego slave'a
+ */
+void MasterWidget::checkVerification(quint32 requestId, const ChunkSummary &recomputed)
+{
+    if (!m_pendingVerifications.contains(requestId))
+        return;
+
+    const PendingVerification pending = m_pendingVerifications.take(requestId);
+    if (m_results.contains(pending.jobId)) {
+        const ChunkRecord &record = m_results[pending.jobId].chunks[pending.chunk];
+
+        if (recomputed.start != record.summary.start || recomputed.end != record.summary.end) {
+            // Przeliczenie przerwane przez zatrzymanie obliczeń obejmuje tylko część fragmentu
+            m_verifyLost++;
+            log(QString("Re-verification of chunk [%1-%2] was interrupted after [%3-%4]")
+                    .arg(record.summary.start).arg(record.summary.end)
+                    .arg(recomputed.start).arg(recomputed.end));
+        } else if (record.summary.sameResult(recomputed)) {
+            m_verifyConfirmed++;
+        } else {
+            m_verifyFailed++;
+            log(QString("Chunk [%1-%2] from %3 FAILED re-verification: %4 primes reported, %5 recomputed")
+                    .arg(recomputed.start).arg(recomputed.end).arg(record.address)
+                    .arg(record.summary.count).arg(recomputed.count));
+        }
+    }
+
+    reportVerificationDone();
+}
+
+/**
+ * Porzuca próbki weryfikacji zlecone rozłączonemu slave'owi - ich wynik już nie nadejdzie.
+ * @param clientSocket Połączenie ze slave'em
+ */
+void MasterWidget::dropVerifications(QTcpSocket *clientSocket)
+{
+    int dropped = 0;
+    for (auto it = m_pendingVerifications.begin(); it != m_pendingVerifications.end();) {
+        if (it->socket == clientSocket) {
+            it = m_pendingVerifications.erase(it);
+            dropped++;
+        } else {
+            ++it;
+        }
+    }
+    if (dropped == 0)
+        return;
+
+    m_verifyLost += dropped;
+    log(QString("%1 re-verification samples were lost with %2")
+            .arg(dropped).arg(m_clientAddresses.value(clientSocket)));
+    reportVerificationDone();
+}
+
+/**
+ * Zapisuje w dzienniku wynik próbkowej weryfikacji, gdy nie czeka już żadna próbka.
+ */
+void MasterWidget::reportVerificationDone()
+{
+    if (!m_pendingVerifications.isEmpty())
+        return;
+
+    log(QString("Sampled re-verification finished: %1 confirmed, %2 failed, %3 not completed")
+            .arg(m_verifyConfirmed).arg(m_verifyFailed).arg(m_verifyLost));
 }
 
 /**
@@ -357,17 +1623,15 @@ void MasterWidget::on_sortButton_clicked()
 }
 
 /**
- * Sortuje listę znalezionych liczb pierwszych zgodnie z aktualnym trybem sortowania.
- * Wykorzystuje algorytm std::sort z odpowiednim komparatorem, a następnie aktualizuje
- * interfejs użytkownika, aby odzwierciedlić posortowaną listę.
+ * Sortuje listę liczb pierwszych wybranego zadania zgodnie z aktualnym trybem sortowania.
+ * Sortowana jest kopia pokazywana na liście (updatePrimesList), a nie wyniki zadania,
+ * których segmenty są współdzielone z magazynem serwera zapytań.
  */
 void MasterWidget::sortPrimesList()
 {
-    if (m_sortAscending) {
-        std::sort(m_primes.begin(), m_primes.end());
-    } else {
-        std::sort(m_primes.begin(), m_primes.end(), std::greater<quint64>());
-    }
+    if (!m_results.contains(m_selectedJob))
+        return;
 
+    m_primesSorted = true;
     updatePrimesList();
 }
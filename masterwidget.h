@@ -7,6 +7,21 @@
 #include <QList>
 #include <QMap>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include "chunksummary.h"
+#include "primestore.h"
+#include "primestats.h"
+#include "jobscheduler.h"
+#include "tuningresult.h"
+#include "metrics.h"
+
+class QueryServer;
+class ShmRing;
+class UiUpdater;
 
 namespace Ui {
 class MasterWidget;
@@ -20,38 +35,148 @@ public:
     explicit MasterWidget(QWidget *parent = nullptr);
     ~MasterWidget();
 
+    bool startServer(quint16 port, const QHostAddress &address = QHostAddress::Any);
+    void stopServer();
+    quint16 serverPort() const;
+    QString serverError() const;
+    int primeCount() const;
+
+    quint32 addJob(JobType type, JobPriority priority, quint64 start, quint64 end, quint32 modulus = 1);
+
+signals:
+    void slaveFinished(const QString &address, quint32 count);
+
 private slots:
     void on_startServerButton_clicked();
     void on_stopServerButton_clicked();
     void on_distributeButton_clicked();
     void on_verifyButton_clicked();
     void on_sortButton_clicked();
+    void on_cancelJobButton_clicked();
+    void on_jobsTableWidget_itemSelectionChanged();
 
     void handleNewConnection();
     void handleClientDisconnected();
     void processResults();
+    void dispatchQueryRange(quint64 start, quint64 end);
 
 private:
     Ui::MasterWidget *ui;
 
+    // Widoki odświeżane zbiorczo przez UiUpdater
+    enum UiView {
+        PrimeCountView,
+        PrimesListView,
+        JobTableView,
+        ClientListView
+    };
+    UiUpdater *m_uiUpdater;
+    QVector<quint64> m_listAppends;     // liczby wybranego zadania czekające na dopisanie do listy
+
     // Network components
     QTcpServer *m_server;
     QList<QTcpSocket*> m_clients;
     QMap<QTcpSocket*, QString> m_clientAddresses;
+    QMap<QTcpSocket*, TuningResult> m_clientTuning;    // konfiguracja zgłoszona przez slave'a
+    QMap<QTcpSocket*, ShmRing*> m_rings;               // pierścienie slave'ów z tego samego hosta
+    QMap<QTcpSocket*, QByteArray> m_ringPending;       // ramka podzielona między bloki pierścienia
 
     // Data
-    QList<quint64> m_primes;
     bool m_serverRunning;
-    quint64 m_rangeStart;
-    quint64 m_rangeEnd;
     bool m_sortAscending;
+    bool m_primesSorted;        // lista liczb pierwszych jest pokazywana posortowana
+
+    // Jobs
+    struct ChunkRecord {
+        ChunkSummary summary;   // podsumowanie zgłoszone przez slave'a
+        QString address;        // slave, który policzył fragment
+        bool transferOk;        // czy odebrane liczby zgadzają się z podsumowaniem
+    };
+    struct JobResults {
+        QList<QVector<quint64>> segments;   // posortowane liczby pierwsze zakończonych fragmentów, współdzielone z m_store
+        quint64 segmentPrimes = 0;          // łączna liczba liczb pierwszych w segments
+        QList<ChunkRecord> chunks;
+        QList<PrimeStats> statsPieces;
+        bool reported = false;  // zakończenie zadania zostało już obsłużone
+    };
+    struct Assignment {
+        JobTask task;
+        QTcpSocket *socket;
+        QVector<PrimeRange> remaining;  // części fragmentu, dla których nie ma jeszcze wyników
+        QElapsedTimer dispatched;       // czas od wysłania fragmentu do slave'a
+    };
+    JobScheduler m_scheduler;
+    QMap<quint32, JobResults> m_results;
+    QList<Assignment> m_assignments;
+    quint32 m_selectedJob;      // zadanie pokazywane na liście liczb pierwszych (0 = brak)
+
+    // Verification
+    struct PendingVerification {
+        quint32 jobId;
+        int chunk;              // indeks fragmentu w JobResults::chunks
+        QTcpSocket *socket;     // slave przeliczający fragment
+    };
+    QMap<quint32, PendingVerification> m_pendingVerifications;  // identyfikator zlecenia -> próbka
+    QMap<QPair<QTcpSocket*, quint32>, QVector<quint64>> m_pendingPrimes;
+    quint32 m_nextVerificationId;
+    int m_verifyConfirmed;
+    int m_verifyFailed;
+    int m_verifyLost;           // próbki bez wyniku (rozłączenie slave'a, przerwane przeliczenie)
+
+    // Query service
+    struct QueryTask {
+        PrimeRange range;       // część zakresu zleconego slave'owi i jeszcze nieodebranego
+        QTcpSocket *socket;
+    };
+    PrimeStore m_store;
+    QThread m_queryThread;
+    QueryServer *m_queryServer;
+    QList<QueryTask> m_queryTasks;
+    int m_nextQueryClient;
+
+    // Metrics
+    struct ConnectionMetrics {
+        Counter *framesReceived = nullptr;
+        Counter *bytesReceived = nullptr;
+        Counter *framesSent = nullptr;
+        Counter *bytesSent = nullptr;
+        Gauge *backlog = nullptr;
+        MetricLabels labels;    // serie połączenia są usuwane z rejestru po rozłączeniu
+    };
+    QMap<QTcpSocket*, ConnectionMetrics> m_connectionMetrics;
+    Counter *m_primesIngested;
+    Gauge *m_connectedSlaves;
+    Histogram *m_chunkLatency;
 
+    void processFrames(QTcpSocket *clientSocket, QIODevice *device);
+    void attachRing(QTcpSocket *clientSocket, const QString &name);
+    void drainRing(QTcpSocket *clientSocket, bool limit = true);
+    void closeRing(QTcpSocket *clientSocket);
     void updateClientList();
+    quint64 receivedPrimes(quint32 jobId) const;
+    QVector<quint64> jobPrimes(quint32 jobId) const;
     void updatePrimesList();
     void updatePrimesList(quint64 prime);
+    void appendPrimesList();
     void log(const QString &message);
     void updatePrimeCount();
     void sortPrimesList();
+    void updateJobTable();
+    void dispatchTasks();
+    void releaseAssignments(QTcpSocket *clientSocket);
+    void completeAssignment(QTcpSocket *clientSocket, quint32 jobId, const ChunkSummary &summary);
+    bool isAssigned(QTcpSocket *clientSocket, quint32 jobId, quint64 start, quint64 end) const;
+    void finishJob(quint32 jobId);
+    void recordChunk(QTcpSocket *clientSocket, quint32 jobId, const ChunkSummary &reported);
+    void startSampledVerification(quint32 jobId);
+    void checkVerification(quint32 requestId, const ChunkSummary &recomputed);
+    void dropVerifications(QTcpSocket *clientSocket);
+    void reportVerificationDone();
+    void recordStatistics(QTcpSocket *clientSocket, quint32 jobId, const PrimeStats &stats);
+    void reportStatistics(quint32 jobId);
+    void storeQueryRange(QTcpSocket *clientSocket, const ChunkSummary &summary, const QByteArray &encodedPrimes);
+    QStringList checkCoverage(quint32 jobId) const;
+    void removeConnectionMetrics(QTcpSocket *clientSocket);
     double primeCountApproximation(quint64 x);
 };
 
@@ -0,0 +1,482 @@
+#include "metrics.h"
+#include <QTcpSocket>
+#include <QMutexLocker>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+/**
+ * Zamienia znaki specjalne wartości etykiety zgodnie z formatem tekstowym Prometheusa.
+ */
+QString escapeLabelValue(QString value)
+{
+    return value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+}
+
+/**
+ * Formatuje etykiety serii jako listę key="value" rozdzieloną przecinkami.
+ * @param extra Dodatkowa, już sformatowana etykieta (np. le="0.5" dla przedziałów histogramu)
+ */
+QString formatLabels(const MetricLabels &labels, const QString &extra = QString())
+{
+    QStringList parts;
+    for (const auto &label : labels) {
+        parts << QString("%1=\"%2\"").arg(label.first, escapeLabelValue(label.second));
+    }
+    if (!extra.isEmpty()) parts << extra;
+
+    return parts.isEmpty() ? QString() : "{" + parts.join(',') + "}";
+}
+
+QString formatNumber(double value)
+{
+    return QString::number(value, 'g', 12);
+}
+
+} // namespace
+
+/**
+ * Zwraca indeks shardu przypisany bieżącemu wątkowi.
+ * Każdy wątek przy pierwszym wywołaniu dostaje kolejny numer, dzięki czemu do liczby
+ * kMetricShards wątków aktualizacje metryk nie współdzielą linii pamięci podręcznej.
+ */
+int metricShardIndex()
+{
+    static std::atomic<int> nextIndex{0};
+    thread_local int index = nextIndex.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return index;
+}
+
+/**
+ * Zwraca sumę wartości licznika ze wszystkich shardów.
+ */
+quint64 Counter::value() const
+{
+    quint64 total = 0;
+    for (const Shard &shard : m_shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * Konstruktor klasy Histogram.
+ * @param bounds Rosnące górne granice przedziałów w jednostkach obserwowanych wartości
+ * @param scale Mnożnik przeliczający jednostki obserwacji na jednostki eksportowane (np. 1e-6 dla µs -> s)
+ */
+Histogram::Histogram(const QVector<quint64> &bounds, double scale) :
+    m_bounds(bounds.mid(0, kMaxHistogramBuckets)),
+    m_scale(scale)
+{
+}
+
+/**
+ * Rejestruje pojedynczą obserwację w shardzie bieżącego wątku.
+ * @param value Wartość w jednostkach, w których podano granice przedziałów
+ */
+void Histogram::observe(quint64 value)
+{
+    int bucket = 0;
+    while (bucket < m_bounds.size() && value > m_bounds[bucket]) {
+        bucket++;
+    }
+
+    Shard &shard = m_shards[metricShardIndex()];
+    shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+/**
+ * Zwraca skumulowane liczności przedziałów (ostatni element odpowiada przedziałowi +Inf).
+ */
+QVector<quint64> Histogram::cumulativeCounts() const
+{
+    QVector<quint64> counts(m_bounds.size() + 1, 0);
+    for (const Shard &shard : m_shards) {
+        for (int i = 0; i < counts.size(); i++) {
+            counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (int i = 1; i < counts.size(); i++) {
+        counts[i] += counts[i - 1];
+    }
+    return counts;
+}
+
+/**
+ * Zwraca sumę wszystkich obserwacji w jednostkach obserwacji.
+ */
+quint64 Histogram::sum() const
+{
+    quint64 total = 0;
+    for (const Shard &shard : m_shards) {
+        total += shard.sum.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * Zwraca globalny rejestr metryk procesu.
+ */
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+/**
+ * Wyszukuje serię o podanej nazwie i etykietach. Wymaga zablokowanego m_mutex.
+ */
+MetricsRegistry::Series *MetricsRegistry::find(const QString &name, const MetricLabels &labels) const
+{
+    for (const auto &series : m_series) {
+        if (series->name == name && series->labels == labels)
+            return series.get();
+    }
+    return nullptr;
+}
+
+/**
+ * Dodaje nową serię do rejestru. Wymaga zablokowanego m_mutex.
+ */
+MetricsRegistry::Series *MetricsRegistry::add(const QString &name, const QString &help,
+                                              const MetricLabels &labels, Type type)
+{
+    std::unique_ptr<Series> series(new Series);
+    series->name = name;
+    series->help = help;
+    series->labels = labels;
+    series->type = type;
+
+    m_series.push_back(std::move(series));
+    return m_series.back().get();
+}
+
+/**
+ * Zwraca licznik o podanej nazwie i etykietach, tworząc go przy pierwszym wywołaniu.
+ * Rejestracja jest kosztowna (blokada), dlatego wskaźnik należy pobrać raz, poza gorącą pętlą.
+ * Zwrócony wskaźnik pozostaje ważny do końca działania procesu albo do usunięcia serii przez remove().
+ */
+Counter *MetricsRegistry::counter(const QString &name, const QString &help, const MetricLabels &labels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Series *series = find(name, labels);
+    if (!series) {
+        series = add(name, help, labels, Type::Counter);
+        series->counter.reset(new Counter);
+    }
+
+    Q_ASSERT(series->type == Type::Counter);
+    return series->counter.get();
+}
+
+/**
+ * Zwraca wskaźnik o podanej nazwie i etykietach, tworząc go przy pierwszym wywołaniu.
+ */
+Gauge *MetricsRegistry::gauge(const QString &name, const QString &help, const MetricLabels &labels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Series *series = find(name, labels);
+    if (!series) {
+        series = add(name, help, labels, Type::Gauge);
+        series->gauge.reset(new Gauge);
+    }
+
+    Q_ASSERT(series->type == Type::Gauge);
+    return series->gauge.get();
+}
+
+/**
+ * Zwraca histogram o podanej nazwie i etykietach, tworząc go przy pierwszym wywołaniu.
+ * @param bounds Górne granice przedziałów w jednostkach obserwacji
+ * @param scale Mnożnik przeliczający jednostki obserwacji na jednostki eksportowane
+ */
+Histogram *MetricsRegistry::histogram(const QString &name, const QString &help,
+                                      const QVector<quint64> &bounds, double scale,
+                                      const MetricLabels &labels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Series *series = find(name, labels);
+    if (!series) {
+        series = add(name, help, labels, Type::Histogram);
+        series->histogram.reset(new Histogram(bounds, scale));
+    }
+
+    Q_ASSERT(series->type == Type::Histogram);
+    return series->histogram.get();
+}
+
+/**
+ * Usuwa wszystkie serie o dokładnie takich etykietach, np. metryki zamkniętego połączenia,
+ * aby liczba serii nie rosła z każdym ponownym połączeniem. Wskaźniki do usuniętych serii
+ * przestają być ważne.
+ */
+void MetricsRegistry::remove(const MetricLabels &labels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_series.erase(std::remove_if(m_series.begin(), m_series.end(),
+                                  [&labels](const std::unique_ptr<Series> &series) {
+                                      return series->labels == labels;
+                                  }),
+                   m_series.end());
+}
+
+/**
+ * Generuje migawkę wszystkich metryk w formacie tekstowym Prometheusa (wersja 0.0.4).
+ * Serie o tej samej nazwie są grupowane pod wspólnymi liniami HELP i TYPE.
+ */
+QByteArray MetricsRegistry::prometheusText() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QStringList names;
+    for (const auto &series : m_series) {
+        if (!names.contains(series->name))
+            names << series->name;
+    }
+
+    QString text;
+    for (const QString &name : names) {
+        bool header = false;
+
+        for (const auto &series : m_series) {
+            if (series->name != name) continue;
+
+            if (!header) {
+                const char *type = series->type == Type::Counter ? "counter"
+                                   : series->type == Type::Gauge ? "gauge" : "histogram";
+                text += QString("# HELP %1 %2\n# TYPE %1 %3\n").arg(name, series->help, type);
+                header = true;
+            }
+
+            switch (series->type) {
+            case Type::Counter:
+                text += name + formatLabels(series->labels) + " "
+                        + QString::number(series->counter->value()) + "\n";
+                break;
+
+            case Type::Gauge:
+                text += name + formatLabels(series->labels) + " "
+                        + QString::number(series->gauge->value()) + "\n";
+                break;
+
+            case Type::Histogram: {
+                const Histogram *histogram = series->histogram.get();
+                QVector<quint64> bounds = histogram->bounds();
+                QVector<quint64> counts = histogram->cumulativeCounts();
+
+                for (int i = 0; i < bounds.size(); i++) {
+                    QString le = QString("le=\"%1\"").arg(formatNumber(bounds[i] * histogram->scale()));
+                    text += name + "_bucket" + formatLabels(series->labels, le) + " "
+                            + QString::number(counts[i]) + "\n";
+                }
+                text += name + "_bucket" + formatLabels(series->labels, "le=\"+Inf\"") + " "
+                        + QString::number(counts.last()) + "\n";
+                text += name + "_sum" + formatLabels(series->labels) + " "
+                        + formatNumber(histogram->sum() * histogram->scale()) + "\n";
+                text += name + "_count" + formatLabels(series->labels) + " "
+                        + QString::number(counts.last()) + "\n";
+                break;
+            }
+            }
+        }
+    }
+
+    return text.toUtf8();
+}
+
+/**
+ * Generuje migawkę wszystkich metryk w formacie JSON.
+ */
+QByteArray MetricsRegistry::jsonSnapshot() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonArray metrics;
+    for (const auto &series : m_series) {
+        QJsonObject labels;
+        for (const auto &label : series->labels) {
+            labels.insert(label.first, label.second);
+        }
+
+        QJsonObject metric;
+        metric.insert("name", series->name);
+        metric.insert("labels", labels);
+
+        switch (series->type) {
+        case Type::Counter:
+            metric.insert("type", "counter");
+            metric.insert("value", static_cast<double>(series->counter->value()));
+            break;
+
+        case Type::Gauge:
+            metric.insert("type", "gauge");
+            metric.insert("value", static_cast<double>(series->gauge->value()));
+            break;
+
+        case Type::Histogram: {
+            const Histogram *histogram = series->histogram.get();
+            QVector<quint64> bounds = histogram->bounds();
+            QVector<quint64> counts = histogram->cumulativeCounts();
+
+            QJsonArray buckets;
+            for (int i = 0; i < bounds.size(); i++) {
+                QJsonObject bucket;
+                bucket.insert("le", bounds[i] * histogram->scale());
+                bucket.insert("count", static_cast<double>(counts[i]));
+                buckets.append(bucket);
+            }
+
+            metric.insert("type", "histogram");
+            metric.insert("buckets", buckets);
+            metric.insert("sum", histogram->sum() * histogram->scale());
+            metric.insert("count", static_cast<double>(counts.last()));
+            break;
+        }
+        }
+
+        metrics.append(metric);
+    }
+
+    QJsonObject root;
+    root.insert("metrics", metrics);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * Konstruktor klasy MetricsHttpHandler - tworzy serwer TCP obsługujący zapytania HTTP o metryki.
+ */
+MetricsHttpHandler::MetricsHttpHandler(QObject *parent) :
+    QObject(parent),
+    m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsHttpHandler::handleNewConnection);
+}
+
+/**
+ * Uruchamia nasłuchiwanie. Musi być wywołana w wątku, w którym żyje obiekt.
+ */
+bool MetricsHttpHandler::listen(quint16 port, const QHostAddress &address)
+{
+    return m_server->listen(address, port);
+}
+
+QString MetricsHttpHandler::errorString() const
+{
+    return m_server->errorString();
+}
+
+/**
+ * Obsługuje nowe połączenie HTTP.
+ */
+void MetricsHttpHandler::handleNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, &MetricsHttpHandler::handleRequest);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+/**
+ * Obsługuje zapytanie HTTP po odebraniu kompletnego nagłówka.
+ * - GET /metrics: format tekstowy Prometheusa
+ * - GET /metrics.json: migawka w formacie JSON
+ * Po wysłaniu odpowiedzi połączenie jest zamykane.
+ */
+void MetricsHttpHandler::handleRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    // Czekamy na kompletny nagłówek; zbyt długie zapytania są odrzucane
+    QByteArray pending = socket->peek(8192);
+    if (!pending.contains("\r\n\r\n")) {
+        if (pending.size() >= 8192) socket->abort();
+        return;
+    }
+
+    QByteArray requestLine = socket->readLine().trimmed();
+    socket->readAll();
+
+    QList<QByteArray> parts = requestLine.split(' ');
+    QByteArray method = parts.value(0);
+    QByteArray path = parts.value(1);
+
+    QByteArray status = "200 OK";
+    QByteArray contentType;
+    QByteArray body;
+
+    if (method != "GET") {
+        status = "405 Method Not Allowed";
+        contentType = "text/plain";
+        body = "Method not allowed\n";
+    } else if (path == "/metrics") {
+        contentType = "text/plain; version=0.0.4";
+        body = MetricsRegistry::instance().prometheusText();
+    } else if (path == "/metrics.json") {
+        contentType = "application/json";
+        body = MetricsRegistry::instance().jsonSnapshot();
+    } else {
+        status = "404 Not Found";
+        contentType = "text/plain";
+        body = "Not found\n";
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: " + contentType + "\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body;
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+/**
+ * Konstruktor klasy MetricsServer - uruchamia osobny wątek dla serwera HTTP,
+ * dzięki czemu odczyt metryk działa także wtedy, gdy wątek interfejsu jest przeciążony.
+ */
+MetricsServer::MetricsServer() :
+    m_handler(new MetricsHttpHandler)
+{
+    m_handler->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, m_handler, &QObject::deleteLater);
+    m_thread.start();
+}
+
+/**
+ * Destruktor klasy MetricsServer - zatrzymuje wątek serwera HTTP.
+ */
+MetricsServer::~MetricsServer()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+/**
+ * Uruchamia serwer HTTP z metrykami na podanym porcie.
+ * @return true jeśli serwer nasłuchuje
+ */
+bool MetricsServer::start(quint16 port, const QHostAddress &address)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(m_handler, [&]() {
+        ok = m_handler->listen(port, address);
+        m_error = m_handler->errorString();
+    }, Qt::BlockingQueuedConnection);
+
+    return ok;
+}
+
+QString MetricsServer::errorString() const
+{
+    return m_error;
+}
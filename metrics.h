@@ -0,0 +1,149 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QMutex>
+#include <QList>
+#include <QPair>
+#include <QTcpServer>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Liczba shardów, na które rozkładane są aktualizacje metryk z różnych wątków
+const int kMetricShards = 64;
+// Maksymalna liczba przedziałów histogramu (bez przedziału +Inf)
+const int kMaxHistogramBuckets = 16;
+
+using MetricLabels = QList<QPair<QString, QString>>;
+
+int metricShardIndex();
+
+class Counter
+{
+public:
+    void add(quint64 value = 1)
+    {
+        m_shards[metricShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    quint64 value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<quint64> value{0};
+    };
+
+    Shard m_shards[kMetricShards];
+};
+
+class Gauge
+{
+public:
+    void set(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(qint64 value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+class Histogram
+{
+public:
+    Histogram(const QVector<quint64> &bounds, double scale);
+
+    void observe(quint64 value);
+
+    QVector<quint64> bounds() const { return m_bounds; }
+    double scale() const { return m_scale; }
+    QVector<quint64> cumulativeCounts() const;
+    quint64 sum() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<quint64> counts[kMaxHistogramBuckets + 1];
+        std::atomic<quint64> sum{0};
+
+        Shard() { for (auto &count : counts) count.store(0, std::memory_order_relaxed); }
+    };
+
+    QVector<quint64> m_bounds;
+    double m_scale;
+    Shard m_shards[kMetricShards];
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    Counter *counter(const QString &name, const QString &help, const MetricLabels &labels = {});
+    Gauge *gauge(const QString &name, const QString &help, const MetricLabels &labels = {});
+    Histogram *histogram(const QString &name, const QString &help, const QVector<quint64> &bounds,
+                         double scale = 1.0, const MetricLabels &labels = {});
+    void remove(const MetricLabels &labels);
+
+    QByteArray prometheusText() const;
+    QByteArray jsonSnapshot() const;
+
+private:
+    MetricsRegistry() = default;
+
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        QString name;
+        QString help;
+        MetricLabels labels;
+        Type type;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    Series *find(const QString &name, const MetricLabels &labels) const;
+    Series *add(const QString &name, const QString &help, const MetricLabels &labels, Type type);
+
+    mutable QMutex m_mutex;
+    std::vector<std::unique_ptr<Series>> m_series;
+};
+
+class MetricsHttpHandler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsHttpHandler(QObject *parent = nullptr);
+
+    bool listen(quint16 port, const QHostAddress &address);
+    QString errorString() const;
+
+private slots:
+    void handleNewConnection();
+    void handleRequest();
+
+private:
+    QTcpServer *m_server;
+};
+
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    bool start(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+    QString errorString() const;
+
+private:
+    QThread m_thread;
+    MetricsHttpHandler *m_handler;
+    QString m_error;
+};
+
+#endif // METRICS_H
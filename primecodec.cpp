@@ -0,0 +1,70 @@
+#include "primecodec.h"
+
+namespace {
+
+void appendVarint(QByteArray &data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+} // namespace
+
+/**
+ * Koduje rosnący ciąg liczb pierwszych w postaci skompresowanej.
+ * Pierwsza liczba zapisywana jest w całości, kolejne jako odstęp od poprzedniej; wszystkie
+ * wartości jako varint, więc typowy odstęp zajmuje jeden bajt zamiast ośmiu.
+ * @param primes Wskaźnik na posortowane rosnąco liczby pierwsze
+ * @param count Liczba elementów
+ * @return Zakodowane dane
+ */
+QByteArray encodePrimes(const quint64 *primes, int count)
+{
+    QByteArray data;
+    data.reserve(count + 16);
+
+    quint64 previous = 0;
+    for (int i = 0; i < count; i++) {
+        appendVarint(data, primes[i] - previous);
+        previous = primes[i];
+    }
+    return data;
+}
+
+QByteArray encodePrimes(const QVector<quint64> &primes)
+{
+    return encodePrimes(primes.constData(), primes.size());
+}
+
+/**
+ * Dekoduje ciąg liczb zapisany przez encodePrimes i dopisuje go do wektora.
+ * @param data Zakodowane dane
+ * @param primes Wektor wynikowy
+ * @return false jeśli dane są uszkodzone (urwany varint)
+ */
+bool decodePrimes(const QByteArray &data, QVector<quint64> *primes)
+{
+    quint64 previous = 0;
+    quint64 value = 0;
+    int shift = 0;
+
+    for (char byte : data) {
+        if (shift > 63) return false;
+
+        value |= static_cast<quint64>(static_cast<quint8>(byte) & 0x7F) << shift;
+        if (static_cast<quint8>(byte) & 0x80) {
+            shift += 7;
+            continue;
+        }
+
+        previous += value;
+        primes->append(previous);
+        value = 0;
+        shift = 0;
+    }
+
+    return shift == 0;
+}
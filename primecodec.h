@@ -0,0 +1,12 @@
+#ifndef PRIMECODEC_H
+#define PRIMECODEC_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Kodowanie rosnącej listy liczb pierwszych: pierwsza liczba, a potem odstępy jako varint (LEB128)
+QByteArray encodePrimes(const quint64 *primes, int count);
+QByteArray encodePrimes(const QVector<quint64> &primes);
+bool decodePrimes(const QByteArray &data, QVector<quint64> *primes);
+
+#endif // PRIMECODEC_H
@@ -1,60 +1,306 @@
 #include "primerunnable.h"
+#include "metrics.h"
+#include "primetables.h"
+#include "primecodec.h"
+#include "workerpool.h"
 #include <QMetaObject>
 #include <QThread>
 
-PrimeRunnable::PrimeRunnable(QObject* receiver, volatile bool *stopped, quint64 start, quint64 end)
-    : m_receiver(receiver), m_stopped(stopped), m_start(start), m_end(end)
+namespace {
+
+// Co ile sprawdzonych liczb lokalne liczniki są przenoszone do rejestru metryk
+const quint64 kMetricsFlushInterval = 4096;
+
+// Największa liczba liczb pierwszych w jednej części trybu Collect (1 MiB przed kodowaniem),
+// aby master nie dekodował ramek o rozmiarze całego zakresu zapytania
+const int kMaxCollectPart = 131072;
+
+} // namespace
+
+PrimeRunnable::PrimeRunnable(QObject* receiver, const QSharedPointer<StopFlag> &stop, quint64 start, quint64 end, Mode mode)
+    : m_receiver(receiver), m_stop(stop), m_start(start), m_end(end), m_mode(mode), m_partStart(start),
+      m_modulus(1), m_jobId(0), m_lastProgress(-1), m_reported(0), m_started(false)
 {
+    m_queuedTimer.start();
+    MetricsRegistry::instance().gauge("prime_slave_task_queue_depth",
+                                      "Tasks submitted to the worker pool and not started yet")->add(1);
 }
 
 PrimeRunnable::~PrimeRunnable()
 {
+    // Zadanie usunięte z kolejki bez uruchomienia nie zmniejszyło jeszcze głębokości kolejki
+    if (!m_started) {
+        MetricsRegistry::instance().gauge("prime_slave_task_queue_depth",
+                                          "Tasks submitted to the worker pool and not started yet")->add(-1);
+    }
 }
 
-QList<quint64> PrimeRunnable::getPrimes() const
+ChunkSummary PrimeRunnable::getSummary() const
 {
-    return m_primes;
+    return m_summary;
+}
+
+/**
+ * Ustawia moduł, dla którego w trybie Statistics liczony jest rozkład reszt liczb pierwszych.
+ */
+void PrimeRunnable::setStatisticsModulus(quint32 modulus)
+{
+    m_modulus = modulus;
+}
+
+/**
+ * Ustawia identyfikator zadania mastera przekazywany odbiorcy razem z wynikami trybów Stream i Statistics
+ * (w trybie CountOnly - identyfikator zlecenia weryfikacji).
+ */
+void PrimeRunnable::setJobId(quint32 jobId)
+{
+    m_jobId = jobId;
 }
 
 void PrimeRunnable::run()
 {
-    for (quint64 i = m_start; i <= m_end; i++) {
-        if (*m_stopped) break;
+    m_started = true;
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    // Etykietą jest numer wątku w puli, więc kolejne pule nie tworzą nowych serii
+    const MetricLabels labels = {{"worker", QString::number(WorkerPool::currentSlot())}};
+
+    Counter *tested = metrics.counter("prime_integers_tested_total", "Integers tested for primality", labels);
+    Counter *found = metrics.counter("prime_primes_found_total", "Primes found", labels);
+    Counter *waitTime = metrics.counter("prime_worker_wait_microseconds_total",
+                                        "Time tasks spent queued before a worker picked them up", labels);
+    Counter *computeTime = metrics.counter("prime_worker_compute_microseconds_total",
+                                           "Time workers spent computing", labels);
+    Histogram *chunkDuration = metrics.histogram("prime_chunk_duration_seconds",
+                                                 "Time to compute one chunk on a worker",
+                                                 {1000, 10000, 100000, 500000, 1000000, 5000000,
+                                                  10000000, 30000000, 60000000, 300000000},
+                                                 1e-6);
+
+    metrics.gauge("prime_slave_task_queue_depth", "Tasks submitted to the worker pool and not started yet")->add(-1);
+    Gauge *running = metrics.gauge("prime_slave_tasks_running", "Tasks currently executing on workers");
+    running->add(1);
+
+    waitTime->add(static_cast<quint64>(m_queuedTimer.nsecsElapsed() / 1000));
+
+    QElapsedTimer computeTimer;
+    computeTimer.start();
+
+    quint64 testedLocal = 0;
+    quint64 foundLocal = 0;
 
-        if (isPrime(i)) {
-            m_primes.append(i);
-            QMetaObject::invokeMethod(m_receiver, "primeFound",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(quint64, i));
+    m_summary = ChunkSummary();
+    m_summary.start = m_start;
+    m_partStart = m_start;
+    if (m_mode == Statistics) m_stats.reset(m_start, m_modulus);
+
+    quint64 segmentLeft = SegmentSize;
+
+    quint64 i = m_start;
+    for (; i <= m_end; i++) {
+        if (m_stop->stopped) break;
+
+        bool prime = isPrime(i, &m_stop->stopped);
+        if (m_stop->stopped) break; // przerwany test nie jest wynikiem
+
+        if (prime) {
+            m_summary.add(i);
+            foundLocal++;
+            if (m_mode == Stream) {
+                m_segment.append(i);
+            } else if (m_mode == Collect) {
+                m_collected.append(i);
+                if (m_collected.size() >= kMaxCollectPart) flushCollected(m_partStart, i);
+            } else if (m_mode == Statistics) {
+                m_stats.add(i);
+            }
+        }
+
+        if (++testedLocal == kMetricsFlushInterval) {
+            tested->add(testedLocal);
+            found->add(foundLocal);
+            testedLocal = 0;
+            foundLocal = 0;
+
+            if (m_mode == Stream || m_mode == Statistics) reportProgress(i);
+        }
+
+        if (--segmentLeft == 0) {
+            flushSegment();
+            segmentLeft = SegmentSize;
         }
     }
+    flushSegment();
+
+    tested->add(testedLocal);
+    found->add(foundLocal);
+
+    quint64 computeUs = static_cast<quint64>(computeTimer.nsecsElapsed() / 1000);
+    computeTime->add(computeUs);
+    chunkDuration->observe(computeUs);
+    running->add(-1);
+
+    // Po zatrzymaniu podsumowanie obejmuje tylko faktycznie sprawdzoną część zakresu,
+    // dzięki czemu master wykryje brakujący fragment
+    if (i > m_end) {
+        m_summary.end = m_end;
+    } else if (i > m_start) {
+        m_summary.end = i - 1;
+    } else {
+        m_summary.start = m_start + 1;
+        m_summary.end = m_start;
+    }
+
+    if ((m_mode == Stream || m_mode == Statistics) && !m_summary.isEmpty()) sendProgress(m_summary.end);
 
-    QMetaObject::invokeMethod(m_receiver, "calculationFinished",
+    // Zadanie bez odbiorcy (np. próba autotunera) mierzy tylko koszt obliczeń
+    if (!m_receiver)
+        return;
+
+    if (m_mode == Statistics) {
+        m_stats.finish(m_summary.end);
+        m_stats.summary = m_summary;
+        QMetaObject::invokeMethod(m_receiver, "statisticsFinished",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint32, m_jobId),
+                                  Q_ARG(PrimeStats, m_stats));
+        return;
+    }
+
+    if (m_mode == Collect) {
+        // Ostatnia część kończy się tam, gdzie podsumowanie całego zakresu
+        if (m_summary.isEmpty()) {
+            flushCollected(m_summary.start, m_summary.end);
+        } else {
+            flushCollected(m_partStart, m_summary.end);
+        }
+        return;
+    }
+
+    if (m_mode == Stream) {
+        QMetaObject::invokeMethod(m_receiver, "calculationFinished",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint32, m_jobId),
+                                  Q_ARG(ChunkSummary, m_summary));
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "verificationFinished",
                               Qt::QueuedConnection,
-                              Q_ARG(QList<quint64>, m_primes));
+                              Q_ARG(quint32, m_jobId),
+                              Q_ARG(ChunkSummary, m_summary));
 }
 
-bool PrimeRunnable::isPrime(quint64 n)
+/**
+ * Przekazuje odbiorcy część zakresu trybu Collect: zakodowane liczby pierwsze zebrane od
+ * poprzedniej części razem z podsumowaniem tej części. Kodowanie odbywa się w wątku roboczym,
+ * wątek interfejsu tylko wysyła gotową ramkę.
+ * @param start Początek części
+ * @param end Koniec części (ostatnia sprawdzona liczba)
+ */
+void PrimeRunnable::flushCollected(quint64 start, quint64 end)
 {
-    if (n <= 1) return false;
-    if (n <= 3) return true;
-    if (n % 2 == 0 || n % 3 == 0) return false;
+    ChunkSummary part;
+    part.start = start;
+    part.end = end;
+    for (quint64 prime : m_collected) {
+        part.add(prime);
+    }
 
-    quint64 i = 5;
-    while (i * i <= n) {
-        if (*m_stopped) return false;
+    QMetaObject::invokeMethod(m_receiver, "collectFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(ChunkSummary, part),
+                              Q_ARG(QByteArray, encodePrimes(m_collected)));
+    m_collected.clear();
+    m_partStart = end + 1;
+}
 
-        if (n % i == 0 || n % (i + 2) == 0)
-            return false;
+/**
+ * Przekazuje odbiorcy liczby pierwsze zebrane w bieżącym segmencie (tylko tryb Stream).
+ * Segment trafia do odbiorcy przed podsumowaniem fragmentu, bo oba wywołania są kolejkowane.
+ */
+void PrimeRunnable::flushSegment()
+{
+    if (m_segment.isEmpty())
+        return;
+    if (!m_receiver) {
+        m_segment.clear();
+        return;
+    }
 
-        i += 6;
+    QMetaObject::invokeMethod(m_receiver, "primesFound",
+                              Qt::QueuedConnection,
+                              Q_ARG(quint32, m_jobId),
+                              Q_ARG(QVector<quint64>, m_segment));
+    m_segment.clear();
+}
 
-        if (i % 1000 == 0) {
-            double progress = static_cast<double>(i * i) / n * 100.0;
-            QMetaObject::invokeMethod(m_receiver, "updateProgress",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(int, qMin(static_cast<int>(progress), 99)));
-        }
+/**
+ * Przekazuje odbiorcy postęp obliczeń, gdy postęp części zmieni się o co najmniej 1%.
+ * @param current Ostatnia sprawdzona liczba
+ */
+void PrimeRunnable::reportProgress(quint64 current)
+{
+    double fraction = static_cast<double>(current - m_start + 1) / (static_cast<double>(m_end - m_start) + 1.0);
+    int percent = qMin(static_cast<int>(fraction * 100.0), 99);
+    if (percent == m_lastProgress)
+        return;
+
+    m_lastProgress = percent;
+    sendProgress(current);
+}
+
+/**
+ * Zgłasza odbiorcy liczby sprawdzone od poprzedniego zgłoszenia. Odbiorca sumuje je dla
+ * fragmentu mastera, do którego należy część, więc kilka fragmentów liczonych naraz
+ * nie nadpisuje nawzajem swojego postępu.
+ * @param current Ostatnia sprawdzona liczba
+ */
+void PrimeRunnable::sendProgress(quint64 current)
+{
+    quint64 tested = current - m_start + 1;
+    if (!m_receiver || tested <= m_reported) return;
+
+    QMetaObject::invokeMethod(m_receiver, "updateProgress",
+                              Qt::QueuedConnection,
+                              Q_ARG(quint32, m_jobId),
+                              Q_ARG(quint64, current),
+                              Q_ARG(quint64, tested - m_reported));
+    m_reported = tested;
+}
+
+/**
+ * Sprawdza, czy n jest liczbą pierwszą, korzystając z tablic generowanych w czasie kompilacji:
+ * bitmapy małych liczb pierwszych, wzorca presieve (2..13), dzielenia przez tablicę SmallPrimes
+ * i dalej przez kandydatów z koła modulo 2310. Funkcja nie ma stanu, więc mogą z niej korzystać
+ * równolegle wszystkie wątki.
+ * @param n Sprawdzana liczba
+ * @param stopped Opcjonalna flaga przerwania - po jej ustawieniu funkcja zwraca false
+ * @return true jeśli n jest liczbą pierwszą
+ */
+bool PrimeRunnable::isPrime(quint64 n, const volatile bool *stopped)
+{
+    using namespace PrimeTables;
+
+    if (n < SmallPrimeLimit) return isSmallPrime(n);
+    if (!passesPresieve(n)) return false;
+
+    for (std::size_t i = FirstTrialPrimeIndex; i < SmallPrimeCount; i++) {
+        quint64 p = SmallPrimes[i];
+        if (p * p > n) return true;
+        if (n % p == 0) return false;
+    }
+
+    quint64 d = TrialWheelBase + Wheel2310::Residues[TrialWheelStart];
+    std::size_t k = TrialWheelStart;
+    while (d <= n / d) {
+        if (stopped && *stopped) return false;
+
+        if (n % d == 0)
+            return false;
+
+        d += Wheel2310::Increments[k];
+        if (++k == Wheel2310::size) k = 0;
     }
 
     return true;
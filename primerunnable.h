@@ -4,26 +4,69 @@
 #include <QRunnable>
 #include <QObject>
 #include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include "chunksummary.h"
+#include "primestats.h"
+
+/**
+ * Flaga zatrzymania wspólna dla zadań jednego zlecenia. Zadania trzymają ją przez wskaźnik
+ * współdzielony, więc żyje do zakończenia ostatniego z nich; zatrzymanej flagi nie zeruje się,
+ * tylko kolejne zlecenia dostają nową.
+ */
+struct StopFlag
+{
+    volatile bool stopped = false;
+};
 
 class PrimeRunnable : public QRunnable
 {
 public:
-    PrimeRunnable(QObject* receiver, volatile bool *stopped, quint64 start, quint64 end);
+    enum Mode {
+        Stream,     // liczby pierwsze są przekazywane do odbiorcy segmentami (primesFound)
+        CountOnly,  // tylko podsumowanie fragmentu, np. do weryfikacji wyników
+        Collect,    // liczby pierwsze wysyłane zakodowanymi częściami z podsumowaniami (collectFinished)
+        Statistics  // tylko statystyki fragmentu (pary, luki, reszty), bez listy liczb pierwszych
+    };
+
+    // Liczba sprawdzanych liczb, po której segment liczb pierwszych trafia do odbiorcy
+    static constexpr quint64 SegmentSize = 65536;
+
+    PrimeRunnable(QObject* receiver, const QSharedPointer<StopFlag> &stop, quint64 start, quint64 end, Mode mode = Stream);
     ~PrimeRunnable();
 
-    QList<quint64> getPrimes() const;
+    ChunkSummary getSummary() const;
+    void setStatisticsModulus(quint32 modulus);
+    void setJobId(quint32 jobId);
+
+    static bool isPrime(quint64 n, const volatile bool *stopped = nullptr);
 
 protected:
     void run() override;
 
 private:
-    bool isPrime(quint64 n);
+    void reportProgress(quint64 current);
+    void sendProgress(quint64 current);
+    void flushSegment();
+    void flushCollected(quint64 start, quint64 end);
 
     QObject* m_receiver;
-    volatile bool *m_stopped;
+    QSharedPointer<StopFlag> m_stop;
     quint64 m_start;
     quint64 m_end;
-    QList<quint64> m_primes;
+    Mode m_mode;
+    ChunkSummary m_summary;
+    QVector<quint64> m_collected;
+    quint64 m_partStart;    // początek bieżącej części trybu Collect
+    QVector<quint64> m_segment;
+    PrimeStats m_stats;
+    quint32 m_modulus;
+    quint32 m_jobId;
+    int m_lastProgress;
+    quint64 m_reported;     // liczba sprawdzonych liczb już zgłoszonych odbiorcy
+    bool m_started;         // zadanie zostało pobrane z kolejki puli
+    QElapsedTimer m_queuedTimer;
 };
 
 #endif // PRIMERUNNABLE_H
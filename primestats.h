@@ -0,0 +1,172 @@
+#ifndef PRIMESTATS_H
+#define PRIMESTATS_H
+
+#include <QDataStream>
+#include <QMetaType>
+#include <QMap>
+#include <QVector>
+#include "chunksummary.h"
+
+/**
+ * Statystyki liczb pierwszych z fragmentu [start, end] liczone w trakcie obliczeń:
+ * pary bliźniacze (p, p+2), kuzynowskie (p, p+4) i „sexy” (p, p+6), pierwsze wystąpienia
+ * każdej luki między kolejnymi liczbami pierwszymi oraz rozkład reszt modulo wybrany moduł.
+ * Slave wysyła tylko te statystyki, a master łączy sąsiednie fragmenty funkcją merge().
+ * Pary i luki przechodzące przez granicę fragmentów są odtwarzane z liczb pierwszych
+ * leżących najwyżej MaxPairDistance - 1 od początku (head) i końca (tail) fragmentu.
+ */
+struct PrimeStats
+{
+    // Największa odległość w liczonych parach
+    static const quint64 MaxPairDistance = 6;
+
+    ChunkSummary summary;           // zakres, liczba i suma kontrolna liczb pierwszych
+    quint64 firstPrime = 0;         // 0 = brak liczb pierwszych we fragmencie
+    quint64 lastPrime = 0;
+    quint64 twins = 0;
+    quint64 cousins = 0;
+    quint64 sexy = 0;
+    QVector<quint64> head;          // liczby pierwsze z [start, start + 5]
+    QVector<quint64> tail;          // liczby pierwsze z [end - 5, end]
+    QMap<quint32, quint64> firstGap; // luka -> najmniejsza liczba pierwsza, po której występuje
+    quint32 modulus = 1;
+    QVector<quint64> residues;      // residues[r] = liczba liczb pierwszych p, dla których p % modulus == r
+
+    void reset(quint64 start, quint32 mod)
+    {
+        *this = PrimeStats();
+        summary.start = start;
+        modulus = qMax<quint32>(mod, 1);
+        residues.fill(0, static_cast<int>(modulus));
+    }
+
+    // Dodaje kolejną (większą od poprzednich) liczbę pierwszą fragmentu
+    void add(quint64 prime)
+    {
+        if (summary.count == 0) {
+            firstPrime = prime;
+        } else {
+            quint32 gap = static_cast<quint32>(prime - lastPrime);
+            if (!firstGap.contains(gap)) firstGap.insert(gap, lastPrime);
+        }
+
+        // Bufor tail trzyma ostatnie liczby pierwsze odległe o mniej niż MaxPairDistance od bieżącej
+        for (quint64 previous : tail) {
+            countPair(prime - previous);
+        }
+        while (!tail.isEmpty() && prime - tail.first() >= MaxPairDistance) {
+            tail.removeFirst();
+        }
+        tail.append(prime);
+
+        if (prime - summary.start < MaxPairDistance) head.append(prime);
+
+        summary.add(prime);
+        residues[static_cast<int>(prime % modulus)]++;
+        lastPrime = prime;
+    }
+
+    // Kończy fragment na end; tail zostaje ograniczony do liczb z [end - 5, end]
+    void finish(quint64 end)
+    {
+        summary.end = end;
+        while (!tail.isEmpty() && end - tail.first() >= MaxPairDistance) {
+            tail.removeFirst();
+        }
+    }
+
+    /**
+     * Dołącza statystyki fragmentu next, który zaczyna się bezpośrednio po końcu tego fragmentu.
+     * Dla fragmentów niesąsiadujących pary i luka na granicy nie są liczone.
+     * @return false jeśli fragmenty nie sąsiadują lub mają różne moduły
+     */
+    bool merge(const PrimeStats &next)
+    {
+        bool adjacent = next.summary.start == summary.end + 1 && modulus == next.modulus;
+
+        if (adjacent) {
+            for (quint64 p : tail) {
+                for (quint64 q : next.head) {
+                    countPair(q - p);
+                }
+            }
+            if (summary.count > 0 && next.summary.count > 0) {
+                quint32 gap = static_cast<quint32>(next.firstPrime - lastPrime);
+                if (!firstGap.contains(gap) || firstGap[gap] > lastPrime) firstGap[gap] = lastPrime;
+            }
+
+            for (quint64 q : next.head) {
+                if (q - summary.start < MaxPairDistance) head.append(q);
+            }
+            for (int r = 0; r < residues.size(); r++) {
+                residues[r] += next.residues.value(r);
+            }
+        }
+
+        for (auto it = next.firstGap.constBegin(); it != next.firstGap.constEnd(); ++it) {
+            if (!firstGap.contains(it.key()) || firstGap[it.key()] > it.value()) firstGap[it.key()] = it.value();
+        }
+
+        QVector<quint64> mergedTail;
+        for (quint64 p : tail) {
+            if (next.summary.end - p < MaxPairDistance) mergedTail.append(p);
+        }
+        tail = mergedTail + next.tail;
+
+        if (summary.count == 0) firstPrime = next.firstPrime;
+        if (next.summary.count > 0) lastPrime = next.lastPrime;
+
+        twins += next.twins;
+        cousins += next.cousins;
+        sexy += next.sexy;
+
+        summary.end = next.summary.end;
+        summary.count += next.summary.count;
+        summary.sum += next.summary.sum;
+        summary.hash ^= next.summary.hash;
+
+        return adjacent;
+    }
+
+    // Rozmiar statystyk w strumieniu QDataStream
+    int serializedSize() const
+    {
+        return ChunkSummary::SerializedSize + 5 * 8 + (4 + 8 * head.size()) + (4 + 8 * tail.size())
+               + (4 + 12 * firstGap.size()) + 4 + (4 + 8 * residues.size());
+    }
+
+    // Największa luka i liczba pierwsza, po której występuje po raz pierwszy (0, 0 jeśli brak)
+    QPair<quint32, quint64> maxGap() const
+    {
+        if (firstGap.isEmpty()) return qMakePair(quint32(0), quint64(0));
+        return qMakePair(firstGap.lastKey(), firstGap.last());
+    }
+
+private:
+    void countPair(quint64 distance)
+    {
+        if (distance == 2) twins++;
+        else if (distance == 4) cousins++;
+        else if (distance == 6) sexy++;
+    }
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const PrimeStats &stats)
+{
+    return stream << stats.summary << stats.firstPrime << stats.lastPrime
+                  << stats.twins << stats.cousins << stats.sexy
+                  << stats.head << stats.tail << stats.firstGap
+                  << stats.modulus << stats.residues;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, PrimeStats &stats)
+{
+    return stream >> stats.summary >> stats.firstPrime >> stats.lastPrime
+                  >> stats.twins >> stats.cousins >> stats.sexy
+                  >> stats.head >> stats.tail >> stats.firstGap
+                  >> stats.modulus >> stats.residues;
+}
+
+Q_DECLARE_METATYPE(PrimeStats)
+
+#endif // PRIMESTATS_H
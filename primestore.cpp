@@ -0,0 +1,279 @@
+#include "primestore.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <algorithm>
+
+/**
+ * Usuwa przedział z listy przedziałów, dzieląc przedziały częściowo pokryte.
+ * @param ranges Lista przedziałów [początek, koniec]
+ * @param removed Usuwany przedział
+ * @return Części przedziałów z ranges nienależące do removed
+ */
+QVector<PrimeRange> subtractRange(const QVector<PrimeRange> &ranges, const PrimeRange &removed)
+{
+    QVector<PrimeRange> result;
+    for (const PrimeRange &range : ranges) {
+        if (range.second < removed.first || range.first > removed.second) {
+            result.append(range);
+            continue;
+        }
+        if (range.first < removed.first) result.append(qMakePair(range.first, removed.first - 1));
+        if (range.second > removed.second) result.append(qMakePair(removed.second + 1, range.second));
+    }
+    return result;
+}
+
+/**
+ * Konstruktor klasy PrimeStore.
+ * @param maxPrimes Maksymalna liczba przechowywanych liczb pierwszych
+ */
+PrimeStore::PrimeStore(quint64 maxPrimes) :
+    m_maxPrimes(maxPrimes)
+{
+}
+
+/**
+ * Zwraca pierwszy segment, który kończy się w x lub później. Wymaga blokady m_lock.
+ */
+QMap<quint64, PrimeStore::Segment>::const_iterator PrimeStore::firstEndingAtOrAfter(quint64 x) const
+{
+    auto it = m_segments.upperBound(x);
+    if (it != m_segments.constBegin()) {
+        auto previous = it - 1;
+        if (previous->end >= x) return previous;
+    }
+    return it;
+}
+
+/**
+ * Dodaje wyniki obliczeń dla zakresu [start, end]. Zapisywane są tylko te części zakresu,
+ * które nie były jeszcze pokryte, więc wielokrotne dodanie tego samego zakresu jest bezpieczne.
+ * Część zakresu zawierająca wszystkie liczby z sortedPrimes jest zapisywana jako wektor
+ * współdzielony z sortedPrimes; pozostałe części są kopiowane i należą tylko do magazynu.
+ * Po przekroczeniu limitu usuwa najdawniej zapisane segmenty Owned (poza właśnie dodanymi).
+ * @param start Początek zakresu
+ * @param end Koniec zakresu
+ * @param sortedPrimes Wszystkie liczby pierwsze z zakresu, posortowane rosnąco
+ * @param ownership Shared, jeśli wywołujący przechowuje sortedPrimes tak długo jak magazyn
+ */
+void PrimeStore::insert(quint64 start, quint64 end, const QVector<quint64> &sortedPrimes, Ownership ownership)
+{
+    const QVector<PrimeRange> pieces = missing(start, end);
+
+    QWriteLocker locker(&m_lock);
+    int inserted = 0;
+    for (const PrimeRange &piece : pieces) {
+        auto from = std::lower_bound(sortedPrimes.constBegin(), sortedPrimes.constEnd(), piece.first);
+        auto to = std::upper_bound(from, sortedPrimes.constEnd(), piece.second);
+
+        Segment segment;
+        segment.start = piece.first;
+        segment.end = piece.second;
+        const bool whole = from == sortedPrimes.constBegin() && to == sortedPrimes.constEnd();
+        segment.shared = whole && ownership == Shared;
+        if (whole) {
+            segment.primes = sortedPrimes;
+        } else {
+            segment.primes.reserve(static_cast<int>(to - from));
+            std::copy(from, to, std::back_inserter(segment.primes));
+        }
+
+        // Zakres mógł zostać pokryty między odczytem braków a blokadą zapisu
+        auto next = m_segments.lowerBound(piece.first);
+        if (next != m_segments.end() && next->start <= piece.second) continue;
+        if (next != m_segments.begin() && (next - 1)->end >= piece.first) continue;
+
+        m_segments.insert(segment.start, segment);
+        if (segment.shared) continue;
+
+        m_storedPrimes += segment.primes.size();
+        m_insertOrder.enqueue(segment.start);
+        inserted++;
+    }
+
+    evict(inserted);
+}
+
+/**
+ * Usuwa najdawniej zapisane segmenty, dopóki liczba liczb pierwszych przekracza limit.
+ * Wymaga blokady zapisu m_lock.
+ * @param keep Liczba ostatnio zapisanych segmentów, które nie mogą zostać usunięte
+ */
+void PrimeStore::evict(int keep)
+{
+    while (m_storedPrimes > m_maxPrimes && m_insertOrder.size() > keep) {
+        auto it = m_segments.find(m_insertOrder.dequeue());
+        m_storedPrimes -= it->primes.size();
+        m_segments.erase(it);
+    }
+}
+
+/**
+ * Usuwa wszystkie zapisane segmenty.
+ */
+void PrimeStore::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_segments.clear();
+    m_insertOrder.clear();
+    m_storedPrimes = 0;
+}
+
+/**
+ * Zwraca części zakresu [start, end], dla których nie ma jeszcze wyników.
+ */
+QVector<PrimeRange> PrimeStore::missing(quint64 start, quint64 end) const
+{
+    QReadLocker locker(&m_lock);
+    return missingLocked(start, end);
+}
+
+/**
+ * Wersja missing() wywoływana pod blokadą m_lock.
+ */
+QVector<PrimeRange> PrimeStore::missingLocked(quint64 start, quint64 end) const
+{
+    QVector<PrimeRange> result;
+    if (end < start) return result;
+
+    quint64 current = start;
+    for (auto it = firstEndingAtOrAfter(start); it != m_segments.constEnd(); ++it) {
+        if (it->start > end) break;
+        if (it->start > current) result.append(qMakePair(current, it->start - 1));
+        if (it->end >= end) return result;
+        current = it->end + 1;
+    }
+
+    result.append(qMakePair(current, end));
+    return result;
+}
+
+/**
+ * Liczy liczby pierwsze w zakresie [start, end].
+ * @return false jeśli zakres nie jest w całości pokryty wynikami
+ */
+bool PrimeStore::count(quint64 start, quint64 end, quint64 *result) const
+{
+    QReadLocker locker(&m_lock);
+    if (!missingLocked(start, end).isEmpty()) return false;
+
+    quint64 total = 0;
+    for (auto it = firstEndingAtOrAfter(start); it != m_segments.constEnd() && it->start <= end; ++it) {
+        auto from = std::lower_bound(it->primes.constBegin(), it->primes.constEnd(), start);
+        auto to = std::upper_bound(from, it->primes.constEnd(), end);
+        total += static_cast<quint64>(to - from);
+    }
+
+    *result = total;
+    return true;
+}
+
+/**
+ * Zwraca co najwyżej maxCount kolejnych liczb pierwszych z zakresu [start, end].
+ * Pozwala przesyłać długie listy porcjami bez kopiowania całego wyniku naraz.
+ * @param result Kolejne liczby pierwsze od start
+ * @return false, jeśli przejrzana część zakresu nie jest już w całości pokryta (segment usunięty)
+ */
+bool PrimeStore::slice(quint64 start, quint64 end, int maxCount, QVector<quint64> *result) const
+{
+    result->clear();
+    QReadLocker locker(&m_lock);
+
+    for (auto it = firstEndingAtOrAfter(start); it != m_segments.constEnd() && it->start <= end; ++it) {
+        auto from = std::lower_bound(it->primes.constBegin(), it->primes.constEnd(), start);
+        auto to = std::upper_bound(from, it->primes.constEnd(), end);
+
+        for (; from != to && result->size() < maxCount; ++from) {
+            result->append(*from);
+        }
+        if (result->size() >= maxCount) break;
+    }
+
+    const quint64 scanned = result->size() >= maxCount ? result->last() : end;
+    return missingLocked(start, scanned).isEmpty();
+}
+
+/**
+ * Szuka k-tej liczby pierwszej (nth(1) == 2) w ciągłym pokryciu zaczynającym się od 2.
+ * @param prime Wynik, jeśli został znaleziony
+ * @param gapStart Pierwsza niepokryta liczba, jeśli wynik nie mieści się w pokryciu
+ */
+bool PrimeStore::nth(quint64 k, quint64 *prime, quint64 *gapStart) const
+{
+    QReadLocker locker(&m_lock);
+
+    quint64 expected = 2;
+    quint64 seen = 0;
+    for (auto it = firstEndingAtOrAfter(expected); it != m_segments.constEnd(); ++it) {
+        if (it->start > expected) break;
+
+        auto from = std::lower_bound(it->primes.constBegin(), it->primes.constEnd(), expected);
+        quint64 available = static_cast<quint64>(it->primes.constEnd() - from);
+        if (seen + available >= k) {
+            *prime = *(from + static_cast<int>(k - seen - 1));
+            return true;
+        }
+
+        seen += available;
+        expected = it->end + 1;
+    }
+
+    *gapStart = expected;
+    return false;
+}
+
+/**
+ * Szuka najmniejszej liczby pierwszej większej od x w ciągłym pokryciu zaczynającym się od x + 1.
+ * @param prime Wynik, jeśli został znaleziony
+ * @param gapStart Pierwsza niepokryta liczba, jeśli wynik nie mieści się w pokryciu
+ */
+bool PrimeStore::nextPrime(quint64 x, quint64 *prime, quint64 *gapStart) const
+{
+    QReadLocker locker(&m_lock);
+
+    quint64 expected = x + 1;
+    for (auto it = firstEndingAtOrAfter(expected); it != m_segments.constEnd(); ++it) {
+        if (it->start > expected) break;
+
+        auto found = std::lower_bound(it->primes.constBegin(), it->primes.constEnd(), expected);
+        if (found != it->primes.constEnd()) {
+            *prime = *found;
+            return true;
+        }
+
+        expected = it->end + 1;
+    }
+
+    *gapStart = expected;
+    return false;
+}
+
+/**
+ * Sprawdza pierwszość x na podstawie zapisanych wyników.
+ * @return false jeśli x nie jest pokryte żadnym segmentem
+ */
+bool PrimeStore::isPrime(quint64 x, bool *result) const
+{
+    QReadLocker locker(&m_lock);
+
+    auto it = firstEndingAtOrAfter(x);
+    if (it == m_segments.constEnd() || it->start > x) return false;
+
+    *result = std::binary_search(it->primes.constBegin(), it->primes.constEnd(), x);
+    return true;
+}
+
+/**
+ * Zwraca liczbę liczb pierwszych należących tylko do magazynu (liczonych do limitu).
+ */
+quint64 PrimeStore::storedPrimes() const
+{
+    QReadLocker locker(&m_lock);
+    return m_storedPrimes;
+}
+
+int PrimeStore::segmentCount() const
+{
+    QReadLocker locker(&m_lock);
+    return m_segments.size();
+}
@@ -0,0 +1,68 @@
+#ifndef PRIMESTORE_H
+#define PRIMESTORE_H
+
+#include <QMap>
+#include <QPair>
+#include <QQueue>
+#include <QVector>
+#include <QReadWriteLock>
+
+using PrimeRange = QPair<quint64, quint64>;
+
+QVector<PrimeRange> subtractRange(const QVector<PrimeRange> &ranges, const PrimeRange &removed);
+
+/**
+ * Magazyn zakresów, z których odpowiada serwer zapytań: fragmentów zakończonych zadań
+ * i zakresów policzonych na potrzeby zapytań. Segmenty przechowują wektory liczb pierwszych
+ * współdzielone niejawnie (bez kopiowania) z wywołującym. Liczba liczb pierwszych należących
+ * tylko do magazynu jest ograniczona; po przekroczeniu limitu usuwane są najdawniej zapisane
+ * z tych segmentów.
+ */
+class PrimeStore
+{
+public:
+    enum Ownership {
+        Owned,      // wektor należy tylko do magazynu - liczy się do limitu i może zostać usunięty
+        Shared      // wektor przechowuje też wywołujący (np. wyniki zadania) - poza limitem
+    };
+
+    // Limit mieści liczby pierwsze z największego zakresu liczonego dla jednego zapytania
+    // (2 * 10^9 liczb, ok. 10^8 liczb pierwszych), więc zapytanie nie usuwa własnych wyników
+    static constexpr quint64 DefaultMaxPrimes = 128 * 1024 * 1024;
+
+    explicit PrimeStore(quint64 maxPrimes = DefaultMaxPrimes);
+
+    void insert(quint64 start, quint64 end, const QVector<quint64> &sortedPrimes, Ownership ownership = Owned);
+    void clear();
+
+    QVector<PrimeRange> missing(quint64 start, quint64 end) const;
+
+    bool count(quint64 start, quint64 end, quint64 *result) const;
+    bool slice(quint64 start, quint64 end, int maxCount, QVector<quint64> *result) const;
+    bool nth(quint64 k, quint64 *prime, quint64 *gapStart) const;
+    bool nextPrime(quint64 x, quint64 *prime, quint64 *gapStart) const;
+    bool isPrime(quint64 x, bool *result) const;
+
+    quint64 storedPrimes() const;
+    int segmentCount() const;
+
+private:
+    struct Segment {
+        quint64 start;
+        quint64 end;
+        QVector<quint64> primes;
+        bool shared;            // wektor współdzielony z wywołującym, nieusuwany przez evict()
+    };
+
+    QMap<quint64, Segment>::const_iterator firstEndingAtOrAfter(quint64 x) const;
+    QVector<PrimeRange> missingLocked(quint64 start, quint64 end) const;
+    void evict(int keep);
+
+    mutable QReadWriteLock m_lock;
+    QMap<quint64, Segment> m_segments;  // kluczem jest początek segmentu; segmenty są rozłączne
+    QQueue<quint64> m_insertOrder;      // początki segmentów Owned w kolejności zapisu
+    quint64 m_maxPrimes;
+    quint64 m_storedPrimes = 0;         // liczby pierwsze segmentów Owned
+};
+
+#endif // PRIMESTORE_H
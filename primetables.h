@@ -0,0 +1,200 @@
+#ifndef PRIMETABLES_H
+#define PRIMETABLES_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Tablice generowane w czasie kompilacji (constexpr) i współdzielone tylko do odczytu
+ * przez wszystkie wątki obliczeniowe:
+ * - małe liczby pierwsze poniżej SmallPrimeLimit,
+ * - koła (wheel) modulo 30, 210 i 2310: reszty względnie pierwsze z modułem i odstępy między nimi,
+ * - wzorzec presieve: bit n mod PresievePeriod jest ustawiony, jeśli n nie dzieli się
+ *   przez żadną z liczb 2, 3, 5, 7, 11, 13.
+ * Dzięki temu żaden silnik nie wylicza dzielników przy każdym kandydacie ani przy starcie zadania.
+ */
+namespace PrimeTables {
+
+constexpr std::uint32_t SmallPrimeLimit = 4096;
+
+namespace detail {
+
+constexpr std::array<bool, SmallPrimeLimit> sieveSmall()
+{
+    std::array<bool, SmallPrimeLimit> composite{};
+    composite[0] = composite[1] = true;
+    for (std::uint32_t i = 2; i * i < SmallPrimeLimit; i++) {
+        if (composite[i]) continue;
+        for (std::uint32_t j = i * i; j < SmallPrimeLimit; j += i) {
+            composite[j] = true;
+        }
+    }
+    return composite;
+}
+
+constexpr std::array<bool, SmallPrimeLimit> SmallComposite = sieveSmall();
+
+constexpr std::size_t countSmallPrimes()
+{
+    std::size_t count = 0;
+    for (std::uint32_t i = 0; i < SmallPrimeLimit; i++) {
+        if (!SmallComposite[i]) count++;
+    }
+    return count;
+}
+
+constexpr std::uint64_t gcd(std::uint64_t a, std::uint64_t b)
+{
+    while (b != 0) {
+        std::uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+constexpr std::size_t countCoprime(std::uint32_t modulus)
+{
+    std::size_t count = 0;
+    for (std::uint32_t r = 1; r <= modulus; r++) {
+        if (gcd(r, modulus) == 1) count++;
+    }
+    return count;
+}
+
+} // namespace detail
+
+constexpr std::size_t SmallPrimeCount = detail::countSmallPrimes();
+
+constexpr std::array<std::uint16_t, SmallPrimeCount> makeSmallPrimes()
+{
+    std::array<std::uint16_t, SmallPrimeCount> primes{};
+    std::size_t index = 0;
+    for (std::uint32_t i = 0; i < SmallPrimeLimit; i++) {
+        if (!detail::SmallComposite[i]) primes[index++] = static_cast<std::uint16_t>(i);
+    }
+    return primes;
+}
+
+constexpr std::array<std::uint16_t, SmallPrimeCount> SmallPrimes = makeSmallPrimes();
+
+// Bitmapa pierwszości dla n < SmallPrimeLimit
+constexpr std::array<std::uint64_t, SmallPrimeLimit / 64> makeSmallPrimeBits()
+{
+    std::array<std::uint64_t, SmallPrimeLimit / 64> bits{};
+    for (std::uint32_t i = 0; i < SmallPrimeLimit; i++) {
+        if (!detail::SmallComposite[i]) bits[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+    return bits;
+}
+
+constexpr std::array<std::uint64_t, SmallPrimeLimit / 64> SmallPrimeBits = makeSmallPrimeBits();
+
+constexpr bool isSmallPrime(std::uint64_t n)
+{
+    return (SmallPrimeBits[n / 64] >> (n % 64)) & 1;
+}
+
+namespace detail {
+
+template <std::uint32_t Modulus>
+constexpr std::array<std::uint32_t, countCoprime(Modulus)> wheelResidues()
+{
+    std::array<std::uint32_t, countCoprime(Modulus)> residues{};
+    std::size_t index = 0;
+    for (std::uint32_t r = 1; r <= Modulus; r++) {
+        if (gcd(r, Modulus) == 1) residues[index++] = r;
+    }
+    return residues;
+}
+
+template <std::uint32_t Modulus>
+constexpr std::array<std::uint8_t, countCoprime(Modulus)> wheelIncrements()
+{
+    constexpr std::size_t size = countCoprime(Modulus);
+    std::array<std::uint8_t, size> increments{};
+    std::array<std::uint32_t, size> residues = wheelResidues<Modulus>();
+    for (std::size_t i = 0; i + 1 < size; i++) {
+        increments[i] = static_cast<std::uint8_t>(residues[i + 1] - residues[i]);
+    }
+    increments[size - 1] = static_cast<std::uint8_t>(Modulus + residues[0] - residues[size - 1]);
+    return increments;
+}
+
+} // namespace detail
+
+/**
+ * Koło modulo Modulus: kolejne reszty względnie pierwsze z modułem (Residues, zaczynając od 1)
+ * oraz odstępy między nimi (Increments; ostatni odstęp przechodzi do następnego obrotu koła).
+ */
+template <std::uint32_t Modulus>
+struct Wheel
+{
+    static constexpr std::uint32_t modulus = Modulus;
+    static constexpr std::size_t size = detail::countCoprime(Modulus);
+    static constexpr std::array<std::uint32_t, size> Residues = detail::wheelResidues<Modulus>();
+    static constexpr std::array<std::uint8_t, size> Increments = detail::wheelIncrements<Modulus>();
+};
+
+using Wheel30 = Wheel<2 * 3 * 5>;
+using Wheel210 = Wheel<2 * 3 * 5 * 7>;
+using Wheel2310 = Wheel<2 * 3 * 5 * 7 * 11>;
+
+static_assert(Wheel30::size == 8, "phi(30) == 8");
+static_assert(Wheel210::size == 48, "phi(210) == 48");
+static_assert(Wheel2310::size == 480, "phi(2310) == 480");
+
+// Liczby pierwsze wykreślane przez wzorzec presieve
+constexpr std::array<std::uint32_t, 6> PresievePrimes = {2, 3, 5, 7, 11, 13};
+constexpr std::uint32_t PresievePeriod = 2 * 3 * 5 * 7 * 11 * 13;
+
+constexpr std::array<std::uint64_t, (PresievePeriod + 63) / 64> makePresievePattern()
+{
+    std::array<std::uint64_t, (PresievePeriod + 63) / 64> bits{};
+    for (std::uint32_t n = 0; n < PresievePeriod; n++) {
+        bool coprime = true;
+        for (std::uint32_t p : PresievePrimes) {
+            if (n % p == 0) coprime = false;
+        }
+        if (coprime) bits[n / 64] |= std::uint64_t(1) << (n % 64);
+    }
+    return bits;
+}
+
+constexpr std::array<std::uint64_t, (PresievePeriod + 63) / 64> PresievePattern = makePresievePattern();
+
+// true, jeśli n nie dzieli się przez żadną z liczb PresievePrimes
+constexpr bool passesPresieve(std::uint64_t n)
+{
+    std::uint64_t r = n % PresievePeriod;
+    return (PresievePattern[r / 64] >> (r % 64)) & 1;
+}
+
+// Indeks pierwszej małej liczby pierwszej spoza PresievePrimes (17)
+constexpr std::size_t FirstTrialPrimeIndex = PresievePrimes.size();
+
+namespace detail {
+
+constexpr std::size_t firstWheelIndexAbove(std::uint64_t base, std::uint64_t limit)
+{
+    std::size_t index = 0;
+    while (index < Wheel2310::size && base + Wheel2310::Residues[index] < limit) {
+        index++;
+    }
+    return index;
+}
+
+} // namespace detail
+
+// Pozycja na kole modulo 2310, od której dzielenie próbne kontynuuje się po wyczerpaniu SmallPrimes
+constexpr std::uint64_t TrialWheelBase = (SmallPrimeLimit / Wheel2310::modulus) * Wheel2310::modulus;
+constexpr std::size_t TrialWheelStart = detail::firstWheelIndexAbove(TrialWheelBase, SmallPrimeLimit);
+
+static_assert(TrialWheelStart < Wheel2310::size, "wheel start must fall inside the first rotation");
+static_assert(SmallPrimes[FirstTrialPrimeIndex] == 17, "trial division starts after the presieve primes");
+static_assert(SmallPrimes[SmallPrimeCount - 1] == 4093, "largest prime below SmallPrimeLimit");
+
+} // namespace PrimeTables
+
+#endif // PRIMETABLES_H
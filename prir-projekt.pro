@@ -13,13 +13,40 @@ SOURCES += \
     mainwindow.cpp \
     masterwidget.cpp \
     slavewidget.cpp \
-    primerunnable.cpp
+    primerunnable.cpp \
+    loadtest.cpp \
+    metrics.cpp \
+    workerpool.cpp \
+    primecodec.cpp \
+    primestore.cpp \
+    queryserver.cpp \
+    jobscheduler.cpp \
+    autotuner.cpp \
+    shmring.cpp \
+    uiupdater.cpp
 
 HEADERS += \
     mainwindow.h \
     masterwidget.h \
     slavewidget.h \
-    primerunnable.h
+    primerunnable.h \
+    chunksummary.h \
+    primestats.h \
+    primetables.h \
+    loadtest.h \
+    metrics.h \
+    workerpool.h \
+    primecodec.h \
+    primestore.h \
+    queryserver.h \
+    jobscheduler.h \
+    autotuner.h \
+    tuningresult.h \
+    shmring.h \
+    uiupdater.h
+
+# shm_open/shm_unlink for the shared-memory transport
+linux: LIBS += -lrt
 
 FORMS += \
     mainwindow.ui \
@@ -0,0 +1,464 @@
+#include "queryserver.h"
+#include "primestore.h"
+#include "primecodec.h"
+#include "primetables.h"
+#include "metrics.h"
+#include <QDataStream>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Największy łączny zakres, który pojedyncze zapytanie może zlecić slave'om do policzenia
+const quint64 kMaxOnDemandSpan = 2000000000ULL;
+// Szerokość zakresu zlecanego przy szukaniu następnej liczby pierwszej (większa od każdej luki w 64 bitach)
+const quint64 kNextPrimeWindow = 4096;
+// Liczba liczb pierwszych w jednej porcji odpowiedzi list
+const int kListBlockSize = 65536;
+// Powyżej tylu niewysłanych bajtów w gnieździe wysyłanie listy czeka na bytesWritten
+const qint64 kMaxBufferedBytes = 1 << 20;
+// Czas, po którym niezałatwione zapytanie kończy się błędem
+const qint64 kQueryTimeoutMs = 120000;
+// Największa 64-bitowa liczba pierwsza
+const quint64 kLargestPrime = 18446744073709551557ULL;
+
+quint64 mulMod(quint64 a, quint64 b, quint64 m)
+{
+    return static_cast<quint64>(static_cast<unsigned __int128>(a) * b % m);
+}
+
+quint64 powMod(quint64 base, quint64 exponent, quint64 m)
+{
+    quint64 result = 1;
+    base %= m;
+    while (exponent > 0) {
+        if (exponent & 1) result = mulMod(result, base, m);
+        base = mulMod(base, base, m);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+/**
+ * Deterministyczny test Millera-Rabina dla liczb 64-bitowych (zestaw świadków Jima Sinclaira).
+ * Używany przez is_prime, gdy liczba nie jest pokryta wynikami - odpowiedź nie wymaga slave'ów.
+ */
+bool isPrimeMillerRabin(quint64 n)
+{
+    if (n < PrimeTables::SmallPrimeLimit) return PrimeTables::isSmallPrime(n);
+    if (!PrimeTables::passesPresieve(n)) return false;
+
+    quint64 d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    for (quint64 witness : {2ULL, 325ULL, 9375ULL, 28178ULL, 450775ULL, 9780504ULL, 1795265022ULL}) {
+        quint64 a = witness % n;
+        if (a == 0) continue;
+
+        quint64 x = powMod(a, d, n);
+        if (x == 1 || x == n - 1) continue;
+
+        bool composite = true;
+        for (int r = 1; r < s && composite; r++) {
+            x = mulMod(x, x, n);
+            if (x == n - 1) composite = false;
+        }
+        if (composite) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Górne ograniczenie k-tej liczby pierwszej: p_k < k(ln k + ln ln k) dla k >= 6.
+ */
+quint64 nthPrimeUpperBound(quint64 k)
+{
+    if (k < 6) return 13;
+
+    double x = static_cast<double>(k);
+    double bound = std::ceil(x * (std::log(x) + std::log(std::log(x))));
+    if (bound >= 18446744073709551615.0) return std::numeric_limits<quint64>::max();
+    return static_cast<quint64>(bound);
+}
+
+} // namespace
+
+/**
+ * Konstruktor klasy QueryServer.
+ * @param store Wspólny magazyn wyników (zapisywany przez mastera, tu tylko czytany)
+ */
+QueryServer::QueryServer(PrimeStore *store, QObject *parent) :
+    QObject(parent),
+    m_store(store),
+    m_server(new QTcpServer(this)),
+    m_retryTimer(new QTimer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &QueryServer::handleNewConnection);
+
+    // Zapytania czekające na wyniki są sprawdzane także cyklicznie (limit czasu)
+    m_retryTimer->setInterval(1000);
+    connect(m_retryTimer, &QTimer::timeout, this, &QueryServer::retryPending);
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    const QMap<quint8, QString> names = {{Count, "count"}, {List, "list"}, {Nth, "nth"},
+                                         {NextPrime, "next_prime"}, {IsPrime, "is_prime"}};
+    for (auto it = names.constBegin(); it != names.constEnd(); ++it) {
+        m_requests[it.key()] = metrics.counter("prime_query_requests_total", "Queries received by the query server",
+                                               {{"op", it.value()}});
+    }
+    m_pendingGauge = metrics.gauge("prime_query_pending", "Queries waiting for ranges computed by slaves");
+    m_latency = metrics.histogram("prime_query_latency_seconds", "Time from receiving a query to its last response",
+                                  {100, 1000, 10000, 100000, 1000000, 10000000, 60000000}, 1e-6);
+}
+
+/**
+ * Uruchamia nasłuchiwanie. Musi być wywołana w wątku, w którym żyje obiekt.
+ */
+bool QueryServer::listen(quint16 port, const QHostAddress &address)
+{
+    if (!m_server->listen(address, port))
+        return false;
+
+    m_retryTimer->start();
+    return true;
+}
+
+/**
+ * Zamyka serwer, rozłącza klientów i porzuca niezałatwione zapytania.
+ * Musi być wywołana w wątku, w którym żyje obiekt.
+ */
+void QueryServer::close()
+{
+    m_retryTimer->stop();
+    m_server->close();
+
+    for (QTcpSocket *socket : findChildren<QTcpSocket*>()) {
+        socket->disconnectFromHost();
+    }
+
+    m_pending.clear();
+    m_streams.clear();
+    m_pendingGauge->set(0);
+}
+
+quint16 QueryServer::serverPort() const
+{
+    return m_server->serverPort();
+}
+
+QString QueryServer::errorString() const
+{
+    return m_server->errorString();
+}
+
+/**
+ * Obsługuje nowe połączenie klienta zapytań.
+ */
+void QueryServer::handleNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, &QueryServer::handleRequest);
+        connect(socket, &QTcpSocket::bytesWritten, this, &QueryServer::continueStreams);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+/**
+ * Odczytuje zapytania klienta. Ramki są odczytywane transakcyjnie, a klient może wysłać
+ * wiele zapytań bez czekania na odpowiedzi - rozróżnia je po identyfikatorze.
+ */
+void QueryServer::handleRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    QDataStream stream(socket);
+
+    forever {
+        stream.startTransaction();
+
+        Query query;
+        query.socket = socket;
+        query.id = 0;
+        query.op = 0;
+        query.a = 0;
+        query.b = 0;
+        query.requested = false;
+
+        stream >> query.id >> query.op;
+        if (query.op == Count || query.op == List) {
+            stream >> query.a >> query.b;
+        } else if (query.op == Nth || query.op == NextPrime || query.op == IsPrime) {
+            stream >> query.a;
+        }
+
+        if (!stream.commitTransaction())
+            return;
+
+        if (!m_requests.contains(query.op)) {
+            // Długość nieznanej ramki jest nieznana, więc dalszej części strumienia nie da się odczytać
+            sendError(socket, query.id, QString("Unknown operation %1").arg(query.op));
+            socket->disconnectFromHost();
+            return;
+        }
+
+        m_requests[query.op]->add();
+        query.timer.start();
+
+        if (!answer(query)) {
+            m_pending.append(query);
+            m_pendingGauge->set(m_pending.size());
+        }
+    }
+}
+
+/**
+ * Próbuje odpowiedzieć na zapytanie z zapisanych wyników.
+ * @return true jeśli zapytanie zostało załatwione (również błędem), false jeśli czeka na wyniki
+ */
+bool QueryServer::answer(Query &query)
+{
+    quint64 prime = 0;
+    quint64 gapStart = 0;
+
+    switch (query.op) {
+    case Count:
+    case List: {
+        if (query.b < query.a) {
+            sendError(query.socket, query.id, "Range end must not be less than range start");
+            return true;
+        }
+
+        quint64 start = qMax<quint64>(query.a, 2);
+        quint64 count = 0;
+        if (query.op == Count && (query.b < start || m_store->count(start, query.b, &count))) {
+            sendValue(query, count);
+            return true;
+        }
+
+        if (query.op == List && (query.b < start || m_store->missing(start, query.b).isEmpty())) {
+            ListStream stream;
+            stream.socket = query.socket;
+            stream.id = query.id;
+            stream.next = start;
+            stream.end = query.b;
+            stream.sent = 0;
+            stream.finished = false;
+            stream.timer = query.timer;
+            m_streams.append(stream);
+            pumpStream(m_streams.last());
+            return true;
+        }
+
+        return requestMissing(query, start, query.b);
+    }
+
+    case Nth: {
+        if (query.a == 0) {
+            sendError(query.socket, query.id, "Index must be at least 1");
+            return true;
+        }
+        if (m_store->nth(query.a, &prime, &gapStart)) {
+            sendValue(query, prime);
+            return true;
+        }
+
+        quint64 upper = nthPrimeUpperBound(query.a);
+        if (upper < gapStart) upper = gapStart + kNextPrimeWindow;
+        return requestMissing(query, gapStart, upper);
+    }
+
+    case NextPrime: {
+        if (query.a >= kLargestPrime) {
+            sendError(query.socket, query.id, "No 64-bit prime is greater than the argument");
+            return true;
+        }
+        if (m_store->nextPrime(query.a, &prime, &gapStart)) {
+            sendValue(query, prime);
+            return true;
+        }
+
+        quint64 upper = gapStart > kLargestPrime - kNextPrimeWindow ? kLargestPrime : gapStart + kNextPrimeWindow;
+        return requestMissing(query, gapStart, upper);
+    }
+
+    case IsPrime: {
+        bool result = false;
+        if (!m_store->isPrime(query.a, &result)) {
+            result = isPrimeMillerRabin(query.a);
+        }
+        sendValue(query, result ? 1 : 0);
+        return true;
+    }
+    }
+
+    return true;
+}
+
+/**
+ * Zgłasza masterowi niepokryte części zakresu [start, end] potrzebne do odpowiedzi.
+ * Zakresy są zgłaszane raz na zapytanie; master pomija części, które już są liczone.
+ * @return false (zapytanie czeka) lub true, jeśli zakres jest zbyt duży i zapytanie zakończono błędem
+ */
+bool QueryServer::requestMissing(Query &query, quint64 start, quint64 end)
+{
+    const QVector<PrimeRange> missing = m_store->missing(start, end);
+
+    quint64 span = 0;
+    for (const PrimeRange &range : missing) {
+        span += range.second - range.first + 1;
+    }
+    if (span > kMaxOnDemandSpan) {
+        sendError(query.socket, query.id,
+                  QString("Answer requires computing %1 numbers, the limit is %2").arg(span).arg(kMaxOnDemandSpan));
+        return true;
+    }
+
+    if (!query.requested) {
+        for (const PrimeRange &range : missing) {
+            emit rangeRequested(range.first, range.second);
+        }
+        query.requested = true;
+    }
+    return false;
+}
+
+/**
+ * Ponawia odpowiedzi na oczekujące zapytania (wywoływana po zapisaniu nowych wyników).
+ * Zapytania zamkniętych połączeń są usuwane, a zbyt długo czekające kończą się błędem.
+ */
+void QueryServer::retryPending()
+{
+    for (int i = 0; i < m_pending.size();) {
+        Query &query = m_pending[i];
+
+        bool done = true;
+        if (query.socket.isNull()) {
+            // Klient rozłączył się przed odpowiedzią
+        } else if (query.timer.elapsed() > kQueryTimeoutMs) {
+            sendError(query.socket, query.id, "Query timed out waiting for slaves");
+        } else {
+            done = answer(query);
+        }
+
+        if (done) {
+            m_pending.removeAt(i);
+        } else {
+            i++;
+        }
+    }
+
+    m_pendingGauge->set(m_pending.size());
+}
+
+/**
+ * Zgłasza ponownie brakujące zakresy wszystkich oczekujących zapytań,
+ * np. po rozłączeniu slave'a, który je liczył.
+ */
+void QueryServer::resubmitPending()
+{
+    for (Query &query : m_pending) {
+        query.requested = false;
+    }
+    retryPending();
+}
+
+/**
+ * Kończy wszystkie oczekujące zapytania błędem, np. gdy żaden slave nie jest podłączony.
+ * @param reason Opis przyczyny wysyłany klientom
+ */
+void QueryServer::failPending(const QString &reason)
+{
+    for (const Query &query : m_pending) {
+        if (!query.socket.isNull()) sendError(query.socket, query.id, reason);
+    }
+
+    m_pending.clear();
+    m_pendingGauge->set(0);
+}
+
+/**
+ * Kontynuuje wysyłanie list, gdy w gniazdach zwolni się miejsce.
+ */
+void QueryServer::continueStreams()
+{
+    for (int i = 0; i < m_streams.size();) {
+        pumpStream(m_streams[i]);
+
+        if (m_streams[i].socket.isNull() || m_streams[i].finished) {
+            m_streams.removeAt(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * Wysyła kolejne porcje listy, dopóki bufor gniazda nie przekroczy limitu.
+ * Po ostatniej porcji wysyła znacznik końca z łączną liczbą liczb. Kolejna porcja jest
+ * pobierana z magazynu dopiero wtedy, gdy klient odbierze poprzednie, więc wolny klient
+ * nie powoduje wzrostu pamięci mastera.
+ */
+void QueryServer::pumpStream(ListStream &stream)
+{
+    QTcpSocket *socket = stream.socket;
+    if (!socket) return;
+
+    while (!stream.finished && socket->bytesToWrite() < kMaxBufferedBytes) {
+        QVector<quint64> block;
+        if (stream.next <= stream.end && !m_store->slice(stream.next, stream.end, kListBlockSize, &block)) {
+            sendError(socket, stream.id, "Listed range was evicted from the result store, repeat the query");
+            stream.finished = true;
+            return;
+        }
+
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+
+        if (block.isEmpty()) {
+            out << stream.id << quint8(ListEnd) << stream.sent;
+            socket->write(data);
+            m_latency->observe(static_cast<quint64>(stream.timer.nsecsElapsed() / 1000));
+            stream.finished = true;
+            return;
+        }
+
+        out << stream.id << quint8(ListBlock) << quint32(block.size()) << encodePrimes(block);
+        socket->write(data);
+
+        stream.sent += block.size();
+        stream.next = block.last() + 1;
+    }
+}
+
+void QueryServer::sendValue(const Query &query, quint64 value)
+{
+    if (query.socket.isNull()) return;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << query.id << quint8(Ok) << value;
+    query.socket->write(data);
+
+    finish(query);
+}
+
+void QueryServer::sendError(QTcpSocket *socket, quint32 id, const QString &message)
+{
+    if (!socket) return;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << id << quint8(Error) << message;
+    socket->write(data);
+}
+
+void QueryServer::finish(const Query &query)
+{
+    m_latency->observe(static_cast<quint64>(query.timer.nsecsElapsed() / 1000));
+}
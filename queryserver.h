@@ -0,0 +1,100 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QList>
+#include <QMap>
+
+class PrimeStore;
+class Counter;
+class Gauge;
+class Histogram;
+
+/**
+ * Serwer zapytań o liczby pierwsze działający we własnym wątku.
+ * Odpowiada na zapytania z wyników zapisanych w PrimeStore; brakujące fragmenty zakresu
+ * zgłasza sygnałem rangeRequested, a zapytanie czeka na nie bez blokowania wątku.
+ *
+ * Protokół (QDataStream, big-endian):
+ * - zapytanie: quint32 id, quint8 op, argumenty
+ *   op 1 count(a, b), op 2 list(a, b), op 3 nth(k), op 4 next_prime(x), op 5 is_prime(x)
+ * - odpowiedź: quint32 id, quint8 status, dane
+ *   status 0: quint64 wynik (dla is_prime 0 lub 1)
+ *   status 1: QString opis błędu
+ *   status 2: quint32 liczba, QByteArray kolejna porcja listy zakodowana przez encodePrimes
+ *   status 3: quint64 liczba wszystkich wysłanych liczb (koniec listy)
+ */
+class QueryServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QueryServer(PrimeStore *store, QObject *parent = nullptr);
+
+    bool listen(quint16 port, const QHostAddress &address);
+    void close();
+    quint16 serverPort() const;
+    QString errorString() const;
+
+signals:
+    void rangeRequested(quint64 start, quint64 end);
+
+public slots:
+    void retryPending();
+    void resubmitPending();
+    void failPending(const QString &reason);
+
+private slots:
+    void handleNewConnection();
+    void handleRequest();
+    void continueStreams();
+
+private:
+    enum Operation : quint8 { Count = 1, List, Nth, NextPrime, IsPrime };
+    enum Status : quint8 { Ok = 0, Error, ListBlock, ListEnd };
+
+    struct Query {
+        QPointer<QTcpSocket> socket;
+        quint32 id;
+        quint8 op;
+        quint64 a;
+        quint64 b;
+        bool requested;         // brakujące zakresy zostały już zgłoszone masterowi
+        QElapsedTimer timer;
+    };
+
+    struct ListStream {
+        QPointer<QTcpSocket> socket;
+        quint32 id;
+        quint64 next;           // pierwsza liczba, od której szukana jest kolejna porcja
+        quint64 end;
+        quint64 sent;
+        bool finished;
+        QElapsedTimer timer;
+    };
+
+    bool answer(Query &query);
+    bool requestMissing(Query &query, quint64 start, quint64 end);
+    void pumpStream(ListStream &stream);
+    void sendValue(const Query &query, quint64 value);
+    void sendError(QTcpSocket *socket, quint32 id, const QString &message);
+    void finish(const Query &query);
+
+    PrimeStore *m_store;
+    QTcpServer *m_server;
+    QTimer *m_retryTimer;
+    QList<Query> m_pending;
+    QList<ListStream> m_streams;
+
+    // Metrics
+    QMap<quint8, Counter*> m_requests;
+    Gauge *m_pendingGauge;
+    Histogram *m_latency;
+};
+
+#endif // QUERYSERVER_H
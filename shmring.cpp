@@ -0,0 +1,405 @@
+#include "shmring.h"
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct ShmRingHeader
+{
+    quint32 magic;
+    quint32 capacity;
+    alignas(64) std::atomic<quint64> head;      // pozycja zapisu (tylko producent)
+    alignas(64) std::atomic<quint64> tail;      // pozycja odczytu (tylko konsument)
+    alignas(64) std::atomic<quint32> waiting;   // konsument czeka na dzwonek
+};
+
+// Liczniki w pamięci współdzielonej muszą działać bez blokad między procesami
+static_assert(std::atomic<quint64>::is_always_lock_free, "64-bit atomics must be lock-free");
+static_assert(std::atomic<quint32>::is_always_lock_free, "32-bit atomics must be lock-free");
+
+namespace {
+
+const quint32 kMagic = 0x50524952;          // "PRIR"
+const quint32 kWrapMarker = 0xFFFFFFFF;     // reszta pierścienia do końca jest pusta
+const quint32 kBlockHeaderSize = sizeof(quint32);
+const quint32 kMinCapacity = 4096;
+
+// Przedrostek nazw segmentów; master otwiera tylko segmenty z tym przedrostkiem
+const char *const kNamePrefix = "/prir-ring-";
+const int kMaxNameLength = 255;
+
+quint64 blockSpan(quint32 size)
+{
+    return (static_cast<quint64>(kBlockHeaderSize) + size + 3) & ~quint64(3);
+}
+
+#ifdef Q_OS_UNIX
+QString systemError(const char *call)
+{
+    return QString("%1: %2").arg(call).arg(QString::fromLocal8Bit(strerror(errno)));
+}
+#endif
+
+} // namespace
+
+ShmRing::ShmRing() :
+    m_header(nullptr),
+    m_data(nullptr),
+    m_mappedSize(0),
+    m_capacity(0),
+    m_owner(false),
+    m_reservedEnd(0),
+    m_readEnd(0)
+{
+}
+
+ShmRing::~ShmRing()
+{
+    close();
+}
+
+/**
+ * Tworzy nazwę segmentu pierścienia z przedrostkiem sprawdzanym przez isValidName().
+ * @param suffix Część nazwy unikalna dla producenta (bez znaku '/')
+ */
+QString ShmRing::makeName(const QString &suffix)
+{
+    return kNamePrefix + suffix;
+}
+
+/**
+ * Sprawdza, czy nazwa zaproponowana przez drugą stronę połączenia wskazuje segment pierścienia,
+ * a nie dowolny inny obiekt pamięci współdzielonej na hoście.
+ */
+bool ShmRing::isValidName(const QString &name)
+{
+    const QString prefix = kNamePrefix;
+    return name.length() > prefix.length() && name.length() <= kMaxNameLength
+           && name.startsWith(prefix) && name.indexOf('/', 1) < 0;
+}
+
+/**
+ * Sprawdza, czy adres należy do tego hosta (pętla zwrotna lub adres jednego z interfejsów),
+ * czyli czy druga strona połączenia może współdzielić z nami pamięć.
+ * Adresy IPv4 zapisane jako IPv6 (::ffff:a.b.c.d) są porównywane jako IPv4.
+ */
+bool ShmRing::isLocalAddress(const QHostAddress &address)
+{
+    if (address.isLoopback())
+        return true;
+
+    for (const QHostAddress &local : QNetworkInterface::allAddresses()) {
+        if (address.isEqual(local, QHostAddress::ConvertV4MappedToIPv4))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Tworzy nowy segment pamięci współdzielonej z pustym pierścieniem (strona producenta).
+ * Segment pozostaje widoczny pod nazwą do wywołania unlink(), tak aby drugi proces
+ * mógł go otworzyć; flaga oczekiwania jest początkowo ustawiona, więc pierwszy zapis
+ * zawsze powiadamia konsumenta.
+ * @param name Nazwa segmentu POSIX (zaczynająca się od '/')
+ * @param capacity Rozmiar obszaru danych w bajtach (potęga dwójki, co najmniej 4 KiB)
+ * @return true, jeśli segment został utworzony i zmapowany
+ */
+bool ShmRing::create(const QString &name, quint32 capacity)
+{
+    close();
+
+    if (capacity < kMinCapacity || (capacity & (capacity - 1)) != 0) {
+        m_error = QString("Invalid ring capacity %1").arg(capacity);
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    const QByteArray path = name.toLocal8Bit();
+    int fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        m_error = systemError("shm_open");
+        return false;
+    }
+
+    const size_t size = sizeof(ShmRingHeader) + capacity;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        m_error = systemError("ftruncate");
+        ::close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+    if (!map(fd, size)) {
+        shm_unlink(path.constData());
+        return false;
+    }
+
+    new (m_header) ShmRingHeader();
+    m_header->capacity = capacity;
+    m_header->waiting.store(1, std::memory_order_relaxed);
+    m_header->magic = kMagic;
+
+    m_name = name;
+    m_capacity = capacity;
+    m_owner = true;
+    m_reservedEnd = 0;
+    return true;
+#else
+    Q_UNUSED(name);
+    m_error = "Shared memory is not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * Otwiera segment utworzony przez inny proces (strona konsumenta).
+ * @param name Nazwa segmentu przekazana przez producenta
+ * @return true, jeśli segment istnieje i zawiera poprawny pierścień
+ */
+bool ShmRing::attach(const QString &name)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    const QByteArray path = name.toLocal8Bit();
+    int fd = shm_open(path.constData(), O_RDWR, 0);
+    if (fd < 0) {
+        m_error = systemError("shm_open");
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        m_error = systemError("fstat");
+        ::close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    if (size < sizeof(ShmRingHeader) + kMinCapacity) {
+        m_error = "Shared memory segment is too small";
+        ::close(fd);
+        return false;
+    }
+    if (!map(fd, size))
+        return false;
+
+    // Pojemność pochodzi z segmentu drugiego procesu; read() maskuje pozycje, więc musi być potęgą dwójki
+    const quint32 capacity = m_header->capacity;
+    if (m_header->magic != kMagic || sizeof(ShmRingHeader) + capacity != size) {
+        m_error = "Shared memory segment does not contain a ring";
+        close();
+        return false;
+    }
+    if (capacity < kMinCapacity || (capacity & (capacity - 1)) != 0) {
+        m_error = QString("Invalid ring capacity %1").arg(capacity);
+        close();
+        return false;
+    }
+
+    m_name = name;
+    m_capacity = capacity;
+    m_readEnd = m_header->tail.load(std::memory_order_relaxed);
+    return true;
+#else
+    Q_UNUSED(name);
+    m_error = "Shared memory is not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * Usuwa nazwę segmentu. Zmapowana pamięć pozostaje dostępna dla obu procesów,
+ * a segment znika po zamknięciu ostatniego mapowania, również po awarii procesu.
+ */
+void ShmRing::unlink()
+{
+#ifdef Q_OS_UNIX
+    if (m_owner)
+        shm_unlink(m_name.toLocal8Bit().constData());
+#endif
+    m_owner = false;
+}
+
+/**
+ * Zwalnia mapowanie pierścienia (i nazwę segmentu, jeśli nie została jeszcze usunięta).
+ */
+void ShmRing::close()
+{
+    unlink();
+
+#ifdef Q_OS_UNIX
+    if (m_header)
+        munmap(m_header, m_mappedSize);
+#endif
+
+    m_header = nullptr;
+    m_data = nullptr;
+    m_mappedSize = 0;
+    m_capacity = 0;
+}
+
+bool ShmRing::map(int fd, size_t size)
+{
+#ifdef Q_OS_UNIX
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        m_error = systemError("mmap");
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+
+    m_header = static_cast<ShmRingHeader*>(memory);
+    m_data = static_cast<char*>(memory) + sizeof(ShmRingHeader);
+    m_mappedSize = size;
+    return true;
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+
+/**
+ * Rezerwuje w pierścieniu ciągły blok na size bajtów. Jeśli blok nie mieści się przed końcem
+ * obszaru danych, reszta obszaru jest oznaczana jako pusta i blok zaczyna się od początku.
+ * Zapisany blok staje się widoczny dla konsumenta po wywołaniu commit().
+ * @return Wskaźnik na zawartość bloku lub nullptr, gdy w pierścieniu brakuje miejsca
+ */
+char *ShmRing::reserve(quint32 size)
+{
+    if (!m_header || size > maxBlockSize())
+        return nullptr;
+
+    const quint64 span = blockSpan(size);
+    quint64 head = m_header->head.load(std::memory_order_relaxed);
+    const quint64 tail = m_header->tail.load(std::memory_order_acquire);
+
+    quint64 offset = head & (m_capacity - 1);
+    const quint64 contiguous = m_capacity - offset;
+    const quint64 skip = span > contiguous ? contiguous : 0;
+    if (head + skip + span - tail > m_capacity)
+        return nullptr;
+
+    if (skip > 0) {
+        memcpy(m_data + offset, &kWrapMarker, sizeof(kWrapMarker));
+        head += skip;
+        offset = 0;
+    }
+
+    memcpy(m_data + offset, &size, sizeof(size));
+    m_reservedEnd = head + span;
+    return m_data + offset + kBlockHeaderSize;
+}
+
+/**
+ * Publikuje blok zarezerwowany przez reserve().
+ */
+void ShmRing::commit()
+{
+    m_header->head.store(m_reservedEnd, std::memory_order_release);
+}
+
+/**
+ * Kopiuje dane do nowego bloku pierścienia.
+ * @return false, gdy w pierścieniu brakuje miejsca (nic nie zostało zapisane)
+ */
+bool ShmRing::write(const char *data, quint32 size)
+{
+    char *block = reserve(size);
+    if (!block)
+        return false;
+
+    memcpy(block, data, size);
+    commit();
+    return true;
+}
+
+/**
+ * Sprawdza po zapisie, czy konsument czeka na dzwonek, i kasuje flagę oczekiwania.
+ * @return true, jeśli producent musi powiadomić konsumenta
+ */
+bool ShmRing::takeDoorbell()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_header->waiting.exchange(0, std::memory_order_acq_rel) != 0;
+}
+
+/**
+ * Zwraca następny blok do odczytu. Dane pozostają ważne do wywołania release().
+ * Pozycje i nagłówki bloków zapisuje drugi proces, więc są sprawdzane przed użyciem;
+ * po zwróceniu Corrupted pierścienia nie można dalej czytać.
+ * @return BlockReady, Empty (pierścień jest pusty) lub Corrupted
+ */
+ShmRing::ReadStatus ShmRing::read(const char **data, quint32 *size)
+{
+    if (!m_header)
+        return Empty;
+
+    forever {
+        const quint64 tail = m_header->tail.load(std::memory_order_relaxed);
+        const quint64 head = m_header->head.load(std::memory_order_acquire);
+        if (tail == head)
+            return Empty;
+        if (head < tail || head - tail > m_capacity)
+            return Corrupted;
+
+        // Bloki zaczynają się na granicy kBlockHeaderSize bajtów, więc nagłówek mieści się przed końcem danych
+        const quint64 offset = tail & (m_capacity - 1);
+        if ((tail % kBlockHeaderSize) != 0 || offset + kBlockHeaderSize > m_capacity)
+            return Corrupted;
+
+        quint32 length;
+        memcpy(&length, m_data + offset, sizeof(length));
+
+        if (length == kWrapMarker) {
+            if (tail + (m_capacity - offset) > head)
+                return Corrupted;
+            m_header->tail.store(tail + (m_capacity - offset), std::memory_order_release);
+            continue;
+        }
+        if (length > maxBlockSize() || offset + blockSpan(length) > m_capacity || tail + blockSpan(length) > head)
+            return Corrupted;
+
+        *data = m_data + offset + kBlockHeaderSize;
+        *size = length;
+        m_readEnd = tail + blockSpan(length);
+        return BlockReady;
+    }
+}
+
+/**
+ * Zwalnia blok zwrócony przez read(), udostępniając jego miejsce producentowi.
+ */
+void ShmRing::release()
+{
+    m_header->tail.store(m_readEnd, std::memory_order_release);
+}
+
+/**
+ * Zgłasza, że konsument opróżnił pierścień i czeka na dzwonek. Dane zapisane tuż przed
+ * ustawieniem flagi mogły nie wywołać powiadomienia, dlatego pierścień jest sprawdzany ponownie.
+ * @return true, jeśli pierścień jest pusty; false, jeśli trzeba kontynuować odczyt
+ */
+bool ShmRing::park()
+{
+    if (!m_header)
+        return true;
+
+    m_header->waiting.store(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_header->head.load(std::memory_order_acquire) != m_header->tail.load(std::memory_order_relaxed)) {
+        m_header->waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct ShmRingHeader;
+class QHostAddress;
+
+/**
+ * Bufor pierścieniowy jeden producent / jeden konsument w pamięci współdzielonej POSIX,
+ * używany do przesyłania ramek wyników od slave'a do mastera działającego na tym samym hoście.
+ * Dane są zapisywane blokami (długość + zawartość); blok nigdy nie jest dzielony na końcu
+ * pierścienia, więc konsument może dekodować ramki bezpośrednio z pamięci współdzielonej.
+ * Pozycje zapisu i odczytu są licznikami atomowymi w nagłówku segmentu, a flaga oczekiwania
+ * mówi producentowi, kiedy konsument czeka na powiadomienie (dzwonek).
+ */
+class ShmRing
+{
+public:
+    enum ReadStatus {
+        BlockReady, // zwrócono blok do odczytu
+        Empty,      // pierścień jest pusty
+        Corrupted   // nagłówek bloku lub pozycje w pierścieniu są niepoprawne
+    };
+
+    ShmRing();
+    ~ShmRing();
+
+    static QString makeName(const QString &suffix);
+    static bool isValidName(const QString &name);
+    static bool isLocalAddress(const QHostAddress &address);
+
+    bool create(const QString &name, quint32 capacity);
+    bool attach(const QString &name);
+    void unlink();
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+    QString name() const { return m_name; }
+    quint32 capacity() const { return m_capacity; }
+    quint32 maxBlockSize() const { return m_capacity / 4; }
+    QString errorString() const { return m_error; }
+
+    // Producent
+    char *reserve(quint32 size);
+    void commit();
+    bool write(const char *data, quint32 size);
+    bool takeDoorbell();
+
+    // Konsument
+    ReadStatus read(const char **data, quint32 *size);
+    void release();
+    bool park();
+
+private:
+    Q_DISABLE_COPY(ShmRing)
+
+    bool map(int fd, size_t size);
+
+    QString m_name;
+    QString m_error;
+    ShmRingHeader *m_header;
+    char *m_data;
+    size_t m_mappedSize;
+    quint32 m_capacity;
+    bool m_owner;           // segment utworzony przez ten obiekt i wciąż widoczny pod nazwą
+    quint64 m_reservedEnd;  // koniec bloku zarezerwowanego przez producenta
+    quint64 m_readEnd;      // koniec bloku zwróconego konsumentowi przez read()
+};
+
+#endif // SHMRING_H
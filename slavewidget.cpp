@@ -1,20 +1,66 @@
 #include "slavewidget.h"
 #include "ui_slavewidget.h"
 #include "primerunnable.h"
+#include "autotuner.h"
+#include "metrics.h"
+#include "shmring.h"
+#include "uiupdater.h"
+#include <QCoreApplication>
 #include <QDataStream>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+// Najmniejsza część zakresu zapytania przydzielana jednemu wątkowi
+const quint64 kMinCollectPiece = 65536;
+
+// Rozmiar pierścienia wyników w pamięci współdzielonej i okres ponawiania zapisu, gdy jest pełny
+const quint32 kRingCapacity = 8 * 1024 * 1024;
+const int kRingRetryInterval = 1;
+
+// Rozmiar ramki znalezionej liczby pierwszej: kod operacji, identyfikator zadania, liczba
+const int kPrimeFrameSize = sizeof(quint8) + sizeof(quint32) + sizeof(quint64);
+
+// Zatrzymana flaga może być jeszcze trzymana przez kończące się zadania, więc nowe zlecenie
+// dostaje nową flagę zamiast zerowania starej
+void renewStopFlag(QSharedPointer<StopFlag> &stop)
+{
+    if (stop->stopped) stop.reset(new StopFlag);
+}
+
+} // namespace
 
 /**
  * Konstruktor klasy SlaveWidget - inicjalizuje interfejs użytkownika i konfiguruje klienta TCP.
  * Tworzy instancję gniazda, łączy odpowiednie sygnały z funkcjami obsługi i inicjalizuje pulę wątków.
- * Ustawia liczbę wątków roboczych na podstawie liczby dostępnych rdzeni procesora.
+ * Liczba wątków roboczych i ich rozmieszczenie na rdzeniach wynikają z ustawień puli w interfejsie.
  */
 SlaveWidget::SlaveWidget(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::SlaveWidget),
-    m_stopped(false)
+    m_progress(0),
+    m_ring(nullptr),
+    m_offeredRing(nullptr),
+    m_primeCount(0),
+    m_stop(new StopFlag),
+    m_collectStop(new StopFlag),
+    m_tuningRunning(false),
+    m_connectAfterTuning(false)
 {
     ui->setupUi(this);
 
+    // Dziennik i pasek postępu są odświeżane zbiorczo, niezależnie od tempa zgłoszeń wątków
+    m_uiUpdater = new UiUpdater(ui->logTextEdit, this);
+    m_uiUpdater->setView(ProgressView, [this]() { showProgress(); });
+
+    // Typ przekazywany z wątków roboczych przez kolejkowane wywołania
+    qRegisterMetaType<ChunkSummary>("ChunkSummary");
+    qRegisterMetaType<PrimeStats>("PrimeStats");
+    qRegisterMetaType<QVector<quint64>>("QVector<quint64>");
+    qRegisterMetaType<TuningResult>("TuningResult");
+
     // Inicjalizacja komponentów sieciowych
     m_socket = new QTcpSocket(this);
 
@@ -30,11 +76,29 @@ SlaveWidget::SlaveWidget(QWidget *parent) :
             this, &SlaveWidget::handleError);
 #endif
 
-    // Inicjalizacja puli wątków
-    m_threadPool = new QThreadPool(this);
-    m_threadPool->setMaxThreadCount(QThread::idealThreadCount());
+    m_ringRetryTimer = new QTimer(this);
+    m_ringRetryTimer->setInterval(kRingRetryInterval);
+    connect(m_ringRetryTimer, &QTimer::timeout, this, &SlaveWidget::flushRing);
 
-    log(QString("Slave initialized with %1 worker threads").arg(QThread::idealThreadCount()));
+    // Inicjalizacja puli wątków
+    m_threadPool = new WorkerPool(workerPoolOptions(), this);
+
+    // Liczniki ruchu sieciowego
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    m_framesSent = metrics.counter("prime_slave_frames_sent_total", "Frames sent by the slave to the master");
+    m_bytesSent = metrics.counter("prime_slave_bytes_sent_total", "Bytes sent by the slave to the master");
+    m_framesReceived = metrics.counter("prime_slave_frames_received_total", "Frames received by the slave from the master");
+    m_bytesReceived = metrics.counter("prime_slave_bytes_received_total", "Bytes received by the slave from the master");
+
+    log(QString("Slave initialized with %1").arg(m_threadPool->placementDescription()));
+
+    // Strojenie działa we własnym wątku; zapisana konfiguracja hosta jest stosowana od razu
+    m_tunerThread.start();
+    TuningResult saved = Autotuner::loadSaved();
+    if (saved.isValid()) {
+        applyTuning(saved);
+        log(QString("Loaded tuned settings for %1: %2").arg(saved.host).arg(saved.description()));
+    }
 }
 
 /**
@@ -43,20 +107,36 @@ SlaveWidget::SlaveWidget(QWidget *parent) :
  */
 SlaveWidget::~SlaveWidget()
 {
-    m_stopped = true;
+    m_stop->stopped = true;
+    m_collectStop->stopped = true;
     if (m_socket->state() == QAbstractSocket::ConnectedState) {
         m_socket->disconnectFromHost();
     }
 
+    m_tunerThread.requestInterruption();
+    m_tunerThread.quit();
+    m_tunerThread.wait();
+
+    closeRings();
     delete ui;
 }
 
 /**
  * Obsługuje kliknięcie przycisku łączenia z serwerem master.
  * Pobiera adres i port z interfejsu użytkownika, a następnie nawiązuje połączenie TCP.
+ * Na hoście bez zapisanej konfiguracji najpierw przeprowadza strojenie, aby próby
+ * nie konkurowały z zadaniami mastera; połączenie następuje po jego zakończeniu.
  */
 void SlaveWidget::on_connectButton_clicked()
 {
+    if (!m_tuning.isValid() && !m_connectAfterTuning) {
+        m_connectAfterTuning = true;
+        ui->connectButton->setEnabled(false);
+        startAutotune();
+        return;
+    }
+    m_connectAfterTuning = false;
+
     QString address = ui->serverAddressEdit->text();
     int port = ui->portSpinBox->value();
 
@@ -71,14 +151,15 @@ void SlaveWidget::on_connectButton_clicked()
  */
 void SlaveWidget::on_disconnectButton_clicked()
 {
-    m_stopped = true;
+    m_stop->stopped = true;
     m_socket->disconnectFromHost();
 }
 
 /**
  * Obsługuje zdarzenie nawiązania połączenia z serwerem master.
  * Aktualizuje interfejs użytkownika, blokując elementy, które nie powinny być modyfikowane
- * podczas aktywnego połączenia.
+ * podczas aktywnego połączenia. Masterowi na tym samym hoście proponuje przesyłanie wyników
+ * przez pamięć współdzieloną.
  */
 void SlaveWidget::handleConnected()
 {
@@ -89,6 +170,9 @@ void SlaveWidget::handleConnected()
 
     log("Connected to master");
     ui->statusLabel->setText("Connected to master");
+
+    sendTuning();
+    offerSharedMemory();
 }
 
 /**
@@ -104,11 +188,17 @@ void SlaveWidget::handleDisconnected()
     ui->portSpinBox->setEnabled(true);
 
 
-    m_stopped = true;
+    // Zadania poprzedniego połączenia kończą się bez wyników, a nierozpoczęte są usuwane z kolejki;
+    // kolejne połączenie dostaje nowe flagi, więc stare zadania nie wysyłają wyników nowemu masterowi
+    m_stop->stopped = true;
+    m_collectStop->stopped = true;
+    int dropped = m_threadPool->clear();
+    if (dropped > 0) log(QString("Dropped %1 queued tasks").arg(dropped));
+    closeRings();
 
     log("Disconnected from master");
     ui->statusLabel->setText("Not connected");
-    ui->progressBar->setValue(0);
+    resetProgress();
 }
 
 /**
@@ -127,134 +217,627 @@ void SlaveWidget::handleError(QAbstractSocket::SocketError error)
 /**
  * Przetwarza dane otrzymane od serwera master.
  * Interpretuje dane zgodnie z protokołem:
- * - kod operacji 1: zlecenie obliczeń - uruchamia poszukiwanie liczb pierwszych w określonym zakresie
+ * - kod operacji 1: fragment zadania - identyfikator i typ zadania, zakres oraz moduł rozkładu reszt;
+ *   zadanie liczb pierwszych odsyła każdą liczbę, zadanie statystyk tylko statystyki części fragmentu
  * - kod operacji 2: zatrzymanie obliczeń - ustawia flagę zatrzymania dla trwających obliczeń
+ * - kod operacji 3: zlecenie weryfikacji (identyfikator, zakres) - przelicza fragment bez przesyłania liczb pierwszych
+ * - kod operacji 4: zakres potrzebny do odpowiedzi na zapytanie - liczby pierwsze wracają w formie zakodowanej
+ * - kod operacji 5: odpowiedź na propozycję pamięci współdzielonej - od tej chwili wyniki trafiają
+ *   do pierścienia albo nadal do połączenia TCP
+ * Ramki są odczytywane transakcyjnie, więc niepełna ramka czeka w buforze gniazda na resztę danych.
  */
 void SlaveWidget::handleData()
 {
-
-
     QDataStream stream(m_socket);
 
-    while (m_socket->bytesAvailable() >= sizeof(quint8)) {
-        quint8 opCode;
+    forever {
+        stream.startTransaction();
+
+        quint8 opCode = 0;
         stream >> opCode;
 
         if (opCode == 1) {
-            if (m_socket->bytesAvailable() < sizeof(quint64) * 2)
-            return;
+            quint32 jobId, modulus;
+            quint8 type;
+            quint64 start, end;
+            stream >> jobId >> type >> start >> end >> modulus;
+            if (!stream.commitTransaction())
+                return;
+
+            m_framesReceived->add();
+            m_bytesReceived->add(sizeof(quint8) * 2 + sizeof(quint32) * 2 + sizeof(quint64) * 2);
+
+            JobType jobType = type == static_cast<quint8>(JobType::Statistics) ? JobType::Statistics : JobType::Primes;
+            log(QString("Received task of job %1: range [%2-%3]").arg(jobId).arg(start).arg(end));
+            startCalculation(jobId, jobType, start, end, modulus);
 
+        } else if (opCode == 3) {
+            quint32 requestId;
+            quint64 start, end;
+            stream >> requestId >> start >> end;
+            if (!stream.commitTransaction())
+                return;
+
+            m_framesReceived->add();
+            m_bytesReceived->add(sizeof(quint8) + sizeof(quint32) + sizeof(quint64) * 2);
+
+            log(QString("Received verification task: range [%1-%2]").arg(start).arg(end));
+            startVerification(requestId, start, end);
 
+        } else if (opCode == 4) {
             quint64 start, end;
             stream >> start >> end;
+            if (!stream.commitTransaction())
+                return;
 
-            log(QString("Received calculation task: range [%1-%2]").arg(start).arg(end));
-            startCalculation(start, end);
+            m_framesReceived->add();
+            m_bytesReceived->add(sizeof(quint8) + sizeof(quint64) * 2);
+
+            log(QString("Received query task: range [%1-%2]").arg(start).arg(end));
+            startCollect(start, end);
 
         } else if (opCode == 2) {
-            m_stopped = true;
+            if (!stream.commitTransaction())
+                return;
+
+            m_framesReceived->add();
+            m_bytesReceived->add(sizeof(quint8));
+
+            m_stop->stopped = true;
+            m_chunks.clear();
             log("Calculation stopped by master");
+
+        } else if (opCode == 5) {
+            quint8 accepted;
+            stream >> accepted;
+            if (!stream.commitTransaction())
+                return;
+
+            m_framesReceived->add();
+            m_bytesReceived->add(sizeof(quint8) * 2);
+
+            if (!m_offeredRing)
+                continue;
+
+            // Oba procesy mają już zmapowany segment, więc jego nazwa nie jest potrzebna
+            m_offeredRing->unlink();
+            if (accepted) {
+                m_ring = m_offeredRing;
+                log(QString("Using shared-memory transport (%1 KiB ring)").arg(m_ring->capacity() / 1024));
+            } else {
+                delete m_offeredRing;
+                log("Master could not attach shared memory, using TCP");
+            }
+            m_offeredRing = nullptr;
+
+        } else if (!stream.commitTransaction()) {
+            return;
         }
     }
 }
 
 /**
- * Rozpoczyna obliczenia poszukiwania liczb pierwszych w określonym zakresie.
+ * Zwraca konfigurację puli wątków wybraną w interfejsie użytkownika.
+ */
+WorkerPoolOptions SlaveWidget::workerPoolOptions() const
+{
+    WorkerPoolOptions options;
+    options.threads = ui->threadsSpinBox->value();
+    options.pinThreads = ui->pinThreadsCheckBox->isChecked();
+    options.physicalCoresOnly = ui->physicalCoresCheckBox->isChecked();
+    options.reserveNetworkCore = ui->reserveCoreCheckBox->isChecked();
+    return options;
+}
+
+/**
+ * Odtwarza pulę wątków, jeśli ustawienia w interfejsie zmieniły się od jej utworzenia.
+ * Pula jest wymieniana tylko wtedy, gdy nie wykonuje żadnych zadań; w przeciwnym razie
+ * nowe ustawienia zostaną zastosowane przy kolejnym zleceniu.
+ */
+void SlaveWidget::ensureWorkerPool()
+{
+    WorkerPoolOptions options = workerPoolOptions();
+    if (options == m_threadPool->options())
+        return;
+
+    if (!m_threadPool->isIdle()) {
+        log("Worker pool settings changed, they will be applied when current tasks finish");
+        return;
+    }
+
+    delete m_threadPool;
+    m_threadPool = new WorkerPool(options, this);
+
+    log(QString("Worker pool reconfigured: %1").arg(m_threadPool->placementDescription()));
+}
+
+/**
+ * Rozpoczyna obliczenia fragmentu zadania mastera w określonym zakresie.
  * Dzieli otrzymany zakres na części i przydziela je do równoległego przetwarzania
  * w puli wątków. Dla każdego zakresu tworzy i uruchamia zadanie PrimeRunnable.
+ * W zadaniu statystyk każdy wątek odsyła tylko statystyki swojej części; pary i luki
+ * na granicach części łączy master.
+ * @param jobId Identyfikator zadania mastera, odsyłany razem z wynikami
+ * @param type Typ zadania
  * @param start Początek zakresu liczbowego
  * @param end Koniec zakresu liczbowego
+ * @param modulus Moduł rozkładu reszt (zadanie statystyk)
  */
-void SlaveWidget::startCalculation(quint64 start, quint64 end)
+void SlaveWidget::startCalculation(quint32 jobId, JobType type, quint64 start, quint64 end, quint32 modulus)
 {
+    ensureWorkerPool();
+    renewStopFlag(m_stop);
 
-    m_stopped = false;
+    // Postęp obejmuje wszystkie fragmenty liczone naraz; nowa seria zaczyna się, gdy poprzednie są gotowe
+    bool idle = std::all_of(m_chunks.cbegin(), m_chunks.cend(), [](const ChunkProgress &chunk) {
+        return chunk.tested > chunk.end - chunk.start;
+    });
+    if (idle) resetProgress();
+    m_chunks.append({jobId, start, end, 0});
 
+    // Kilka części na wątek wyrównuje obciążenie wątków; liczbę części dobiera autotuner
+    quint64 piecesPerThread = m_tuning.isValid() ? m_tuning.piecesPerThread : 1;
 
-    m_primes.clear();
-    ui->progressBar->setValue(0);
+    quint64 rangeSize = end - start + 1;
+    quint64 pieces = qMin<quint64>(m_threadPool->maxThreadCount() * piecesPerThread, rangeSize);
+    quint64 rangePerPiece = rangeSize / pieces;
 
+    log(QString("Starting calculation with %1 threads: %2 pieces of %3 numbers")
+            .arg(m_threadPool->maxThreadCount()).arg(pieces).arg(rangePerPiece));
 
-    log(QString("Starting calculation with %1 threads").arg(m_threadPool->maxThreadCount()));
+    for (quint64 i = 0; i < pieces; i++) {
 
-    int threadCount = m_threadPool->maxThreadCount();
-    quint64 rangeSize = end - start + 1;
-    quint64 rangePerThread = rangeSize / threadCount;
+        quint64 pieceStart = start + i * rangePerPiece;
 
-    for (int i = 0; i < threadCount; i++) {
+        quint64 pieceEnd = (i == pieces - 1) ? end : pieceStart + rangePerPiece - 1;
 
-        quint64 threadStart = start + i * rangePerThread;
+        PrimeRunnable *task = new PrimeRunnable(this, m_stop, pieceStart, pieceEnd,
+                                                type == JobType::Statistics ? PrimeRunnable::Statistics
+                                                                            : PrimeRunnable::Stream);
+        task->setJobId(jobId);
+        task->setStatisticsModulus(modulus);
+        task->setAutoDelete(true);
+        m_threadPool->start(task);
+    }
+}
+
+/**
+ * Rozpoczyna weryfikację fragmentu zleconą przez mastera.
+ * Fragment jest przeliczany w jednym zadaniu w trybie CountOnly - liczby pierwsze nie są
+ * przesyłane, a wynikiem jest wyłącznie podsumowanie z liczbą i sumą kontrolną.
+ * @param requestId Identyfikator zlecenia odsyłany masterowi razem z wynikiem
+ * @param start Początek fragmentu
+ * @param end Koniec fragmentu
+ */
+void SlaveWidget::startVerification(quint32 requestId, quint64 start, quint64 end)
+{
+    ensureWorkerPool();
+    renewStopFlag(m_stop);
+
+    PrimeRunnable *task = new PrimeRunnable(this, m_stop, start, end, PrimeRunnable::CountOnly);
+    task->setJobId(requestId);
+    task->setAutoDelete(true);
+    m_threadPool->start(task);
+}
+
+/**
+ * Rozpoczyna obliczenie zakresu potrzebnego masterowi do odpowiedzi na zapytanie.
+ * Zakres jest dzielony między wątki (nie mniej niż kMinCollectPiece liczb na wątek). Każdy wątek
+ * odsyła swoją część kolejnymi ramkami ograniczonej wielkości, każdą z zakodowaną listą liczb
+ * pierwszych i podsumowaniem jej podzakresu.
+ * Zatrzymanie obliczeń przez mastera nie przerywa tych zadań.
+ * @param start Początek zakresu
+ * @param end Koniec zakresu
+ */
+void SlaveWidget::startCollect(quint64 start, quint64 end)
+{
+    ensureWorkerPool();
+    renewStopFlag(m_collectStop);
 
-        quint64 threadEnd = (i == threadCount - 1) ? end : threadStart + rangePerThread - 1;
+    quint64 rangeSize = end - start + 1;
+    quint64 pieces = qBound<quint64>(1, rangeSize / kMinCollectPiece, m_threadPool->maxThreadCount());
+    quint64 rangePerPiece = rangeSize / pieces;
 
-        log(QString("Thread %1: range [%2-%3]").arg(i).arg(threadStart).arg(threadEnd));
+    for (quint64 i = 0; i < pieces; i++) {
+        quint64 pieceStart = start + i * rangePerPiece;
+        quint64 pieceEnd = (i == pieces - 1) ? end : pieceStart + rangePerPiece - 1;
 
-        PrimeRunnable *task = new PrimeRunnable(this, &m_stopped, threadStart, threadEnd);
+        PrimeRunnable *task = new PrimeRunnable(this, m_collectStop, pieceStart, pieceEnd, PrimeRunnable::Collect);
         task->setAutoDelete(true);
         m_threadPool->start(task);
     }
 }
 
 /**
- * Aktualizuje pasek postępu obliczeń na interfejsie użytkownika.
- * Wywoływana przez zadania PrimeRunnable, aby informować o postępie poszukiwania.
- * @param percent Wartość procentowa postępu (0-100)
+ * Zapamiętuje postęp obliczeń; pasek postępu jest aktualizowany przy najbliższym odświeżeniu.
+ * Wywoływana przez zadania PrimeRunnable, aby informować o postępie poszukiwania. Postęp jest
+ * doliczany do fragmentu mastera, do którego należy część; zgłoszenia zatrzymanych zadań,
+ * których fragmentu już nie ma, są pomijane.
+ * @param jobId Identyfikator zadania mastera
+ * @param position Ostatnia sprawdzona liczba
+ * @param tested Liczby sprawdzone od poprzedniego zgłoszenia części
  */
-void SlaveWidget::updateProgress(int percent)
+void SlaveWidget::updateProgress(quint32 jobId, quint64 position, quint64 tested)
 {
+    quint64 total = 0;
+    quint64 done = 0;
+    for (ChunkProgress &chunk : m_chunks) {
+        if (chunk.jobId == jobId && position >= chunk.start && position <= chunk.end) {
+            chunk.tested += tested;
+        }
+        total += chunk.end - chunk.start + 1;
+        done += qMin(chunk.tested, chunk.end - chunk.start + 1);
+    }
+    if (total == 0)
+        return;
+
+    m_progress = static_cast<int>(static_cast<double>(done) * 100.0 / static_cast<double>(total));
+    m_uiUpdater->invalidate(ProgressView);
+}
 
-    ui->progressBar->setValue(percent);
+/**
+ * Zaczyna nową serię fragmentów: zeruje postęp i licznik znalezionych liczb pierwszych.
+ */
+void SlaveWidget::resetProgress()
+{
+    m_chunks.clear();
+    m_primeCount = 0;
+    m_progress = 0;
+    m_uiUpdater->invalidate(ProgressView);
 }
 
 /**
- * Obsługuje znalezienie nowej liczby pierwszej przez wątek obliczeniowy.
- * Dodaje liczbę do lokalnej listy i wysyła ją do serwera master.
- * Co 100 znalezionych liczb pierwszych, aktualizuje dziennik zdarzeń.
- * @param prime Znaleziona liczba pierwsza
+ * Pokazuje na pasku postępu procent wykonania i liczbę liczb pierwszych znalezionych we fragmentach
+ * liczonych od ostatniej bezczynności slave'a.
  */
-void SlaveWidget::primeFound(quint64 prime)
+void SlaveWidget::showProgress()
 {
-    m_primes.append(prime);
+    ui->progressBar->setValue(m_progress);
+    ui->progressBar->setFormat(QString("%p% - %1 primes").arg(m_primeCount));
+}
+
+/**
+ * Obsługuje segment liczb pierwszych znalezionych przez wątek obliczeniowy.
+ * Wysyła liczby do serwera master jednym zapisem do gniazda (lub kilkoma blokami pierścienia
+ * pamięci współdzielonej), po jednej ramce na liczbę. Liczba znalezionych liczb pierwszych
+ * jest pokazywana na pasku postępu przy najbliższym odświeżeniu interfejsu.
+ * @param jobId Identyfikator zadania mastera
+ * @param primes Liczby pierwsze segmentu
+ */
+void SlaveWidget::primesFound(quint32 jobId, const QVector<quint64> &primes)
+{
+    m_primeCount += static_cast<quint64>(primes.size());
+    m_uiUpdater->invalidate(ProgressView);
+
+    // Przy pamięci współdzielonej ramki są zapisywane bezpośrednio w pierścieniu
+    int sent = (m_ring && m_ringBacklog.isEmpty()) ? writePrimesToRing(jobId, primes) : 0;
+
+    if (sent < primes.size()) {
+        QByteArray data;
+        data.reserve((primes.size() - sent) * kPrimeFrameSize);
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        for (int i = sent; i < primes.size(); i++) {
+            stream << quint8(1) << jobId << primes[i]; // 1 = kod operacji dla znalezionej liczby pierwszej
+        }
+        sendFrames(data, static_cast<quint64>(primes.size() - sent));
+    }
+
+}
+
+/**
+ * Obsługuje zakończenie obliczeń fragmentu przez wątek obliczeniowy.
+ * Aktualizuje dziennik zdarzeń i wysyła do serwera master
+ * podsumowanie fragmentu: zakres, liczbę znalezionych liczb pierwszych i sumę kontrolną.
+ * @param jobId Identyfikator zadania mastera
+ * @param summary Podsumowanie obliczonego fragmentu
+ */
+void SlaveWidget::calculationFinished(quint32 jobId, const ChunkSummary &summary)
+{
+
+    log(QString("Calculation finished. Found %1 prime numbers in [%2-%3]")
+            .arg(summary.count).arg(summary.start).arg(summary.end));
 
     QByteArray data;
+
     QDataStream stream(&data, QIODevice::WriteOnly);
-    stream << quint8(1) << prime; // 1 = kod operacji dla znalezionej liczby pierwszej
+    stream << quint8(2) << jobId << summary; // 2 = kod operacji dla zakończenia obliczeń
 
-    m_socket->write(data);
+    sendFrames(data);
+}
+
+/**
+ * Obsługuje zakończenie weryfikacji fragmentu i odsyła masterowi jego podsumowanie.
+ * @param requestId Identyfikator zlecenia weryfikacji
+ * @param summary Podsumowanie przeliczonego fragmentu
+ */
+void SlaveWidget::verificationFinished(quint32 requestId, const ChunkSummary &summary)
+{
+    log(QString("Verification finished. Found %1 prime numbers in [%2-%3]")
+            .arg(summary.count).arg(summary.start).arg(summary.end));
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(3) << requestId << summary; // 3 = kod operacji dla wyniku weryfikacji
+
+    sendFrames(data);
+}
+
+/**
+ * Odsyła masterowi obliczoną część zakresu zapytania.
+ * @param summary Podsumowanie części zakresu
+ * @param encodedPrimes Liczby pierwsze zakodowane przez encodePrimes
+ */
+void SlaveWidget::collectFinished(const ChunkSummary &summary, const QByteArray &encodedPrimes)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(4) << summary << encodedPrimes; // 4 = kod operacji dla wyniku zakresu zapytania
+
+    sendFrames(data);
+}
+
+/**
+ * Odsyła masterowi statystyki obliczonej części zakresu.
+ * @param jobId Identyfikator zadania mastera
+ * @param stats Statystyki części zakresu
+ */
+void SlaveWidget::statisticsFinished(quint32 jobId, const PrimeStats &stats)
+{
+    log(QString("Statistics finished. Found %1 prime numbers in [%2-%3]")
+            .arg(stats.summary.count).arg(stats.summary.start).arg(stats.summary.end));
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(5) << jobId << stats; // 5 = kod operacji dla statystyk fragmentu
+
+    sendFrames(data);
+}
+
+/**
+ * Obsługuje kliknięcie przycisku strojenia - ponownie dobiera konfigurację obliczeń dla hosta.
+ */
+void SlaveWidget::on_autotuneButton_clicked()
+{
+    startAutotune();
+}
+
+/**
+ * Uruchamia strojenie w wątku autotunera. Próby tworzą własne pule wątków z ustawieniami
+ * z interfejsu (bez rezerwacji rdzenia sieciowego), więc zlecenia mastera liczone w tym czasie
+ * zaniżają wyniki prób.
+ */
+void SlaveWidget::startAutotune()
+{
+    if (m_tuningRunning)
+        return;
+
+    m_tuningRunning = true;
+    ui->autotuneButton->setEnabled(false);
+    log("Autotuning worker settings for this host");
+
+    Autotuner *tuner = new Autotuner(workerPoolOptions());
+    tuner->moveToThread(&m_tunerThread);
+    connect(tuner, &Autotuner::progress, this, &SlaveWidget::log);
+    connect(tuner, &Autotuner::finished, this, &SlaveWidget::tuningFinished);
+    connect(tuner, &Autotuner::finished, tuner, &QObject::deleteLater);
+
+    QMetaObject::invokeMethod(tuner, "run", Qt::QueuedConnection);
+}
+
+/**
+ * Obsługuje zakończenie strojenia: zapisuje i stosuje nową konfigurację oraz zgłasza ją masterowi.
+ * Jeśli połączenie czekało na strojenie, nawiązuje je teraz.
+ * @param result Wynik strojenia (niepoprawny, jeśli strojenie przerwano)
+ */
+void SlaveWidget::tuningFinished(const TuningResult &result)
+{
+    m_tuningRunning = false;
+    ui->autotuneButton->setEnabled(true);
+
+    if (result.isValid()) {
+        Autotuner::save(result);
+        applyTuning(result);
+        log(QString("Autotuning finished: %1").arg(result.description()));
+        sendTuning();
+    } else {
+        log("Autotuning was interrupted, keeping current settings");
+    }
 
-    if (m_primes.size() % 100 == 0) {
-        log(QString("Found %1 prime numbers so far").arg(m_primes.size()));
+    if (m_connectAfterTuning) {
+        ui->connectButton->setEnabled(true);
+        on_connectButton_clicked();
     }
 }
 
 /**
- * Obsługuje zakończenie obliczeń przez wszystkie wątki.
- * Aktualizuje dziennik zdarzeń, ustawia pasek postępu na 100% i wysyła
- * informację do serwera master o zakończeniu obliczeń wraz z liczbą znalezionych liczb pierwszych.
- * @param primes Lista znalezionych liczb pierwszych
+ * Stosuje konfigurację strojenia: liczba części na wątek trafia do kolejnych obliczeń, a liczba
+ * wątków do ustawień puli (pula zostanie odtworzona przy kolejnym zleceniu), ale tylko wtedy,
+ * gdy użytkownik nie wybrał jej sam - pole ma wartość Auto lub poprzednio dostrojoną.
+ * Pozostałe ustawienia puli nie są zmieniane; próby były mierzone z tymi samymi ustawieniami.
+ * @param result Konfiguracja do zastosowania
  */
-void SlaveWidget::calculationFinished(const QList<quint64> &primes)
+void SlaveWidget::applyTuning(const TuningResult &result)
 {
+    const int threads = ui->threadsSpinBox->value();
+    const bool userThreads = threads != 0 && !(m_tuning.isValid() && threads == static_cast<int>(m_tuning.threads));
+    m_tuning = result;
+
+    if (userThreads) {
+        log(QString("Keeping %1 worker threads set by the user, tuned value is %2").arg(threads).arg(result.threads));
+    } else if (threads != static_cast<int>(result.threads)) {
+        ui->threadsSpinBox->setValue(static_cast<int>(result.threads));
+        log(QString("Worker threads set to the tuned value %1").arg(result.threads));
+    }
+    ui->tuningLabel->setText("Tuned: " + result.description());
+}
 
-    log(QString("Calculation finished. Found %1 prime numbers").arg(primes.size()));
-    ui->progressBar->setValue(100);
+/**
+ * Zgłasza masterowi konfigurację hosta (kod operacji 6), jeśli jest znana i slave jest połączony.
+ */
+void SlaveWidget::sendTuning()
+{
+    if (!m_tuning.isValid() || m_socket->state() != QAbstractSocket::ConnectedState)
+        return;
 
     QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(6) << m_tuning; // 6 = kod operacji dla konfiguracji hosta
+
+    sendFrames(data);
+}
+
+/**
+ * Wysyła ramki do mastera: przez pierścień pamięci współdzielonej, jeśli master go przyjął,
+ * w przeciwnym razie przez połączenie TCP. Ramki, które nie mieszczą się w pierścieniu, czekają
+ * w kolejce, a wszystkie późniejsze ramki trafiają za nimi, aby zachować kolejność wyników.
+ * @param data Zserializowane ramki
+ * @param frames Liczba ramek w danych
+ */
+void SlaveWidget::sendFrames(const QByteArray &data, quint64 frames)
+{
+    m_framesSent->add(frames);
+    m_bytesSent->add(data.size());
 
+    if (!m_ring) {
+        m_socket->write(data);
+        return;
+    }
+
+    m_ringBacklog.append(data);
+    flushRing();
+}
+
+/**
+ * Zapisuje ramki znalezionych liczb pierwszych bezpośrednio w blokach pierścienia,
+ * w tym samym formacie co QDataStream (big-endian), bez pośredniego bufora.
+ * @return Liczba zapisanych liczb; pozostałe nie zmieściły się w pierścieniu
+ */
+int SlaveWidget::writePrimesToRing(quint32 jobId, const QVector<quint64> &primes)
+{
+    const int framesPerBlock = static_cast<int>(m_ring->maxBlockSize()) / kPrimeFrameSize;
+
+    int sent = 0;
+    while (sent < primes.size()) {
+        int count = qMin(framesPerBlock, primes.size() - sent);
+        char *block = m_ring->reserve(static_cast<quint32>(count * kPrimeFrameSize));
+        if (!block)
+            break;
+
+        for (int i = 0; i < count; i++) {
+            char *frame = block + i * kPrimeFrameSize;
+            frame[0] = 1; // kod operacji dla znalezionej liczby pierwszej
+            qToBigEndian<quint32>(jobId, frame + sizeof(quint8));
+            qToBigEndian<quint64>(primes[sent + i], frame + sizeof(quint8) + sizeof(quint32));
+        }
+        m_ring->commit();
+        sent += count;
+    }
+
+    if (sent > 0) {
+        m_framesSent->add(static_cast<quint64>(sent));
+        m_bytesSent->add(static_cast<quint64>(sent) * kPrimeFrameSize);
+        ringDoorbell();
+    }
+    return sent;
+}
+
+/**
+ * Proponuje masterowi transport przez pamięć współdzieloną (kod operacji 7), jeśli master
+ * działa na tym samym hoście. Do czasu odpowiedzi wyniki są wysyłane przez TCP.
+ */
+void SlaveWidget::offerSharedMemory()
+{
+    if (!ShmRing::isLocalAddress(m_socket->peerAddress()))
+        return;
+
+    closeRings();
+
+    const QString name = ShmRing::makeName(QString("slave-%1-%2").arg(QCoreApplication::applicationPid())
+                                               .arg(QRandomGenerator::global()->generate(), 8, 16, QChar('0')));
+    ShmRing *ring = new ShmRing;
+    if (!ring->create(name, kRingCapacity)) {
+        log(QString("Shared-memory transport unavailable: %1").arg(ring->errorString()));
+        delete ring;
+        return;
+    }
+    m_offeredRing = ring;
+
+    QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
-    stream << quint8(2) << quint32(primes.size()); // 2 = kod operacji dla zakończenia obliczeń
+    stream << quint8(7) << name; // 7 = kod operacji propozycji pamięci współdzielonej
+
+    sendFrames(data);
+}
+
+/**
+ * Przenosi oczekujące ramki do pierścienia. Bloki mają co najwyżej maxBlockSize() bajtów,
+ * więc długa ramka może zostać podzielona między bloki - master skleja ją przed dekodowaniem.
+ * Gdy pierścień jest pełny, zapis jest ponawiany przez timer.
+ */
+void SlaveWidget::flushRing()
+{
+    if (!m_ring) {
+        m_ringRetryTimer->stop();
+        return;
+    }
+
+    int written = 0;
+    while (written < m_ringBacklog.size()) {
+        quint32 size = qMin<quint32>(m_ring->maxBlockSize(), static_cast<quint32>(m_ringBacklog.size() - written));
+        if (!m_ring->write(m_ringBacklog.constData() + written, size))
+            break;
+        written += static_cast<int>(size);
+    }
+
+    if (written > 0) {
+        m_ringBacklog.remove(0, written);
+        ringDoorbell();
+    }
+
+    if (m_ringBacklog.isEmpty())
+        m_ringRetryTimer->stop();
+    else if (!m_ringRetryTimer->isActive())
+        m_ringRetryTimer->start();
+}
+
+/**
+ * Powiadamia mastera o nowych blokach w pierścieniu (kod operacji 8), jeśli master
+ * opróżnił pierścień i czeka na dzwonek. Dzwonek idzie przez połączenie TCP.
+ */
+void SlaveWidget::ringDoorbell()
+{
+    if (!m_ring->takeDoorbell())
+        return;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint8(8); // 8 = kod operacji dzwonka pierścienia
 
     m_socket->write(data);
+    m_framesSent->add();
+    m_bytesSent->add(data.size());
+}
+
+/**
+ * Zamyka pierścienie pamięci współdzielonej i porzuca ramki czekające na miejsce w pierścieniu.
+ */
+void SlaveWidget::closeRings()
+{
+    m_ringRetryTimer->stop();
+    m_ringBacklog.clear();
+
+    delete m_ring;
+    m_ring = nullptr;
+    delete m_offeredRing;
+    m_offeredRing = nullptr;
 }
 
 /**
  * Dodaje wiadomość do dziennika logów.
- * Dołącza znacznik czasu do wiadomości i wyświetla ją w polu tekstowym logów.
+ * Wiadomość ze znacznikiem czasu trafia do pola tekstowego przy najbliższym odświeżeniu interfejsu.
  * @param message Treść wiadomości do zalogowania
  */
 void SlaveWidget::log(const QString &message)
 {
-
-    ui->logTextEdit->append(QTime::currentTime().toString("[HH:mm:ss] ") + message);
-
+    m_uiUpdater->log(message);
 }
@@ -3,9 +3,22 @@
 
 #include <QWidget>
 #include <QTcpSocket>
-#include <QThreadPool>
 #include <QTime>
 #include <QMessageBox>
+#include <QThread>
+#include <QTimer>
+#include <QSharedPointer>
+#include "chunksummary.h"
+#include "primestats.h"
+#include "jobscheduler.h"
+#include "tuningresult.h"
+#include "workerpool.h"
+
+struct StopFlag;
+
+class Counter;
+class ShmRing;
+class UiUpdater;
 
 namespace Ui {
 class SlaveWidget;
@@ -22,6 +35,7 @@ public:
 private slots:
     void on_connectButton_clicked();
     void on_disconnectButton_clicked();
+    void on_autotuneButton_clicked();
 
     void handleData();
     void handleError(QAbstractSocket::SocketError error);
@@ -29,22 +43,72 @@ private slots:
     void handleDisconnected();
 
     // Sloty dla obliczeń
-    void updateProgress(int percent);
-    void primeFound(quint64 prime);
-    void calculationFinished(const QList<quint64> &primes);
+    void updateProgress(quint32 jobId, quint64 position, quint64 tested);
+    void primesFound(quint32 jobId, const QVector<quint64> &primes);
+    void calculationFinished(quint32 jobId, const ChunkSummary &summary);
+    void verificationFinished(quint32 requestId, const ChunkSummary &summary);
+    void collectFinished(const ChunkSummary &summary, const QByteArray &encodedPrimes);
+    void statisticsFinished(quint32 jobId, const PrimeStats &stats);
+    void tuningFinished(const TuningResult &result);
 
 private:
     Ui::SlaveWidget *ui;
 
+    // Widoki odświeżane zbiorczo przez UiUpdater
+    enum UiView {
+        ProgressView
+    };
+    UiUpdater *m_uiUpdater;
+    int m_progress;
+
     // Network components
     QTcpSocket *m_socket;
+    ShmRing *m_ring;                    // pierścień wyników do mastera na tym samym hoście (nullptr = TCP)
+    ShmRing *m_offeredRing;             // pierścień czekający na odpowiedź mastera
+    QByteArray m_ringBacklog;           // ramki, które nie zmieściły się w pierścieniu
+    QTimer *m_ringRetryTimer;
 
     // Calculation components
-    QThreadPool *m_threadPool;
-    QList<quint64> m_primes;
-    volatile bool m_stopped;
+    WorkerPool *m_threadPool;
+    struct ChunkProgress {
+        quint32 jobId;
+        quint64 start;
+        quint64 end;
+        quint64 tested;     // liczby sprawdzone do tej pory
+    };
+    QList<ChunkProgress> m_chunks;      // fragmenty mastera liczone od ostatniej bezczynności slave'a
+    quint64 m_primeCount;               // liczby pierwsze znalezione w tych fragmentach
+    QSharedPointer<StopFlag> m_stop;            // flaga zadań mastera bieżącego połączenia
+    QSharedPointer<StopFlag> m_collectStop;     // zadania zapytań nie są przerywane przez zatrzymanie obliczeń
+
+    // Autotuning
+    QThread m_tunerThread;
+    TuningResult m_tuning;
+    bool m_tuningRunning;
+    bool m_connectAfterTuning;          // połączenie z masterem czeka na zakończenie strojenia
+
+    // Metrics
+    Counter *m_framesSent;
+    Counter *m_bytesSent;
+    Counter *m_framesReceived;
+    Counter *m_bytesReceived;
 
-    void startCalculation(quint64 start, quint64 end);
+    WorkerPoolOptions workerPoolOptions() const;
+    void ensureWorkerPool();
+    void startCalculation(quint32 jobId, JobType type, quint64 start, quint64 end, quint32 modulus);
+    void startVerification(quint32 requestId, quint64 start, quint64 end);
+    void startCollect(quint64 start, quint64 end);
+    void startAutotune();
+    void applyTuning(const TuningResult &result);
+    void sendTuning();
+    void sendFrames(const QByteArray &data, quint64 frames = 1);
+    int writePrimesToRing(quint32 jobId, const QVector<quint64> &primes);
+    void offerSharedMemory();
+    void flushRing();
+    void ringDoorbell();
+    void closeRings();
+    void resetProgress();
+    void showProgress();
     void log(const QString &message);
 };
 
@@ -0,0 +1,51 @@
+#ifndef TUNINGRESULT_H
+#define TUNINGRESULT_H
+
+#include <QDataStream>
+#include <QMetaType>
+#include <QString>
+
+/**
+ * Konfiguracja obliczeń slave'a wybrana przez autotuner dla danego hosta: liczba wątków
+ * i liczba części fragmentu na wątek, razem z rozmiarami pamięci podręcznej procesora
+ * i przepustowością zmierzoną w próbach. Slave zapisuje ją lokalnie i zgłasza masterowi.
+ */
+struct TuningResult
+{
+    QString host;
+    quint32 cpus = 0;               // liczba procesorów logicznych w chwili strojenia
+    quint32 threads = 0;            // 0 = brak konfiguracji
+    quint32 piecesPerThread = 1;
+    quint32 l1d = 0;                // rozmiary pamięci podręcznej w bajtach (0 = nieznany)
+    quint32 l2 = 0;
+    quint32 l3 = 0;
+    double numbersPerSecond = 0;    // przepustowość najlepszej konfiguracji w próbach
+
+    bool isValid() const { return threads > 0; }
+
+    // Rozmiar konfiguracji w strumieniu QDataStream
+    int serializedSize() const { return (4 + 2 * host.size()) + 4 * 3 + 4 * 3 + 8; }
+
+    QString description() const
+    {
+        return QString("%1 threads, %2 pieces/thread, %3 M numbers/s")
+            .arg(threads).arg(piecesPerThread)
+            .arg(numbersPerSecond / 1e6, 0, 'f', 2);
+    }
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const TuningResult &result)
+{
+    return stream << result.host << result.cpus << result.threads << result.piecesPerThread
+                  << result.l1d << result.l2 << result.l3 << result.numbersPerSecond;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, TuningResult &result)
+{
+    return stream >> result.host >> result.cpus >> result.threads >> result.piecesPerThread
+                  >> result.l1d >> result.l2 >> result.l3 >> result.numbersPerSecond;
+}
+
+Q_DECLARE_METATYPE(TuningResult)
+
+#endif // TUNINGRESULT_H
@@ -0,0 +1,133 @@
+#include "uiupdater.h"
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <QTime>
+
+namespace {
+
+// Częstotliwość odświeżania widżetów (20 Hz)
+const int kRefreshInterval = 50;
+
+// Liczba ostatnich wierszy przechowywanych w dzienniku
+const int kMaxLogLines = 2000;
+
+} // namespace
+
+/**
+ * Konstruktor klasy UiUpdater.
+ * @param logView Pole tekstowe dziennika; jego dokument jest ograniczany do kMaxLogLines wierszy
+ */
+UiUpdater::UiUpdater(QTextEdit *logView, QObject *parent) :
+    QObject(parent),
+    m_logView(logView),
+    m_droppedLines(0)
+{
+    m_logView->document()->setMaximumBlockCount(kMaxLogLines);
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(kRefreshInterval);
+    connect(&m_timer, &QTimer::timeout, this, &UiUpdater::flush);
+}
+
+/**
+ * Rejestruje widok - funkcję odświeżającą fragment interfejsu na podstawie bieżącego stanu.
+ * @param view Identyfikator widoku (mała liczba nieujemna)
+ * @param refresh Funkcja wywoływana przy odświeżeniu, jeśli widok został unieważniony
+ */
+void UiUpdater::setView(int view, const std::function<void()> &refresh)
+{
+    if (view >= m_views.size()) {
+        m_views.resize(view + 1);
+        m_dirty.resize(view + 1);
+    }
+    m_views[view] = refresh;
+}
+
+/**
+ * Oznacza widok jako nieaktualny; zostanie odświeżony najpóźniej po kRefreshInterval ms.
+ * Wielokrotne unieważnienie przed odświeżeniem kończy się jednym wywołaniem funkcji widoku.
+ */
+void UiUpdater::invalidate(int view)
+{
+    if (view < 0 || view >= m_dirty.size())
+        return;
+
+    m_dirty[view] = true;
+    schedule();
+}
+
+/**
+ * Dodaje wiadomość do dziennika. Znacznik czasu pochodzi z chwili zgłoszenia, a wiersz
+ * trafia do pola tekstowego przy najbliższym odświeżeniu.
+ * @param message Treść wiadomości do zalogowania
+ */
+void UiUpdater::log(const QString &message)
+{
+    if (m_pendingLines.size() >= kMaxLogLines) {
+        m_pendingLines.removeFirst();
+        m_droppedLines++;
+    }
+    m_pendingLines.append(QTime::currentTime().toString("[HH:mm:ss] ") + message);
+    schedule();
+}
+
+/**
+ * Odświeża unieważnione widoki i dopisuje zebrane wiersze dziennika.
+ */
+void UiUpdater::flush()
+{
+    m_timer.stop();
+
+    for (int view = 0; view < m_views.size(); view++) {
+        if (!m_dirty[view]) continue;
+
+        m_dirty[view] = false;
+        if (m_views[view]) m_views[view]();
+    }
+
+    appendLogLines();
+}
+
+void UiUpdater::schedule()
+{
+    if (!m_timer.isActive())
+        m_timer.start();
+}
+
+/**
+ * Dopisuje oczekujące wiersze jedną operacją edycji dokumentu. Widok przewija się na koniec
+ * tylko wtedy, gdy był przewinięty na koniec przed dopisaniem.
+ */
+void UiUpdater::appendLogLines()
+{
+    if (m_pendingLines.isEmpty())
+        return;
+
+    if (m_droppedLines > 0) {
+        m_pendingLines.prepend(QString("... %1 log lines dropped ...").arg(m_droppedLines));
+        m_droppedLines = 0;
+    }
+
+    QScrollBar *scrollBar = m_logView->verticalScrollBar();
+    const bool atBottom = scrollBar->value() == scrollBar->maximum();
+
+    QTextDocument *document = m_logView->document();
+    bool firstLine = document->isEmpty();
+
+    QTextCursor cursor(document);
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+    for (const QString &line : m_pendingLines) {
+        if (!firstLine) cursor.insertBlock();
+        cursor.insertText(line);
+        firstLine = false;
+    }
+    cursor.endEditBlock();
+
+    m_pendingLines.clear();
+
+    if (atBottom)
+        scrollBar->setValue(scrollBar->maximum());
+}
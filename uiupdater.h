@@ -0,0 +1,44 @@
+#ifndef UIUPDATER_H
+#define UIUPDATER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+
+class QTextEdit;
+
+/**
+ * Warstwa odświeżania interfejsu: zbiera wiersze dziennika i informacje o zmienionym stanie,
+ * a widżety aktualizuje zbiorczo z ograniczoną częstotliwością. Koszt interfejsu nie zależy
+ * wtedy od liczby zdarzeń (ramek, segmentów, fragmentów), tylko od częstotliwości odświeżania.
+ * Dziennik przechowuje ograniczoną liczbę ostatnich wierszy.
+ */
+class UiUpdater : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UiUpdater(QTextEdit *logView, QObject *parent = nullptr);
+
+    void setView(int view, const std::function<void()> &refresh);
+    void invalidate(int view);
+    void log(const QString &message);
+
+public slots:
+    void flush();
+
+private:
+    void schedule();
+    void appendLogLines();
+
+    QTextEdit *m_logView;
+    QTimer m_timer;
+    QVector<std::function<void()>> m_views;
+    QVector<bool> m_dirty;
+    QStringList m_pendingLines;
+    int m_droppedLines;     // wiersze usunięte z kolejki, bo pojawiły się szybciej niż mieści dziennik
+};
+
+#endif // UIUPDATER_H
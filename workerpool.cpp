@@ -0,0 +1,479 @@
+#include "workerpool.h"
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QMap>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <algorithm>
+#include <climits>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace {
+
+// Numer bieżącego wątku w jego puli (0 poza wątkami puli)
+thread_local int currentWorkerSlot = 0;
+
+/**
+ * Odczytuje pierwszą linię pliku sysfs.
+ */
+QString readSysfs(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString();
+
+    return QString::fromLatin1(file.readLine()).trimmed();
+}
+
+/**
+ * Zamienia listę procesorów w formacie jądra (np. "0-3,8,10-11") na wektor numerów.
+ */
+QVector<int> parseCpuList(const QString &list)
+{
+    QVector<int> cpus;
+    for (const QString &part : list.split(',')) {
+        if (part.isEmpty()) continue;
+
+        QStringList bounds = part.split('-');
+        int first = bounds.value(0).toInt();
+        int last = bounds.size() > 1 ? bounds.value(1).toInt() : first;
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.append(cpu);
+        }
+    }
+    return cpus;
+}
+
+#ifdef Q_OS_LINUX
+/**
+ * Ogranicza wątek do podanych procesorów. Pusta lista przywraca wszystkie procesory online.
+ */
+bool setThreadAffinity(pthread_t thread, const QVector<int> &cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (cpus.isEmpty()) {
+        for (const CpuInfo &info : detectCpuTopology()) {
+            if (info.cpu < CPU_SETSIZE) CPU_SET(info.cpu, &set);
+        }
+    } else {
+        for (int cpu : cpus) {
+            if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+    }
+
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+#endif
+
+/**
+ * Zamienia rozmiar pamięci podręcznej w formacie sysfs (np. "32K", "16M") na bajty.
+ */
+quint32 parseCacheSize(const QString &size)
+{
+    if (size.isEmpty())
+        return 0;
+
+    quint32 multiplier = 1;
+    QString digits = size;
+    if (size.endsWith('K')) {
+        multiplier = 1024;
+        digits.chop(1);
+    } else if (size.endsWith('M')) {
+        multiplier = 1024 * 1024;
+        digits.chop(1);
+    }
+    return digits.toUInt() * multiplier;
+}
+
+QString formatCpuList(const QVector<int> &cpus)
+{
+    QStringList parts;
+    for (int cpu : cpus) {
+        parts << QString::number(cpu);
+    }
+    return parts.join(',');
+}
+
+} // namespace
+
+/**
+ * Odczytuje topologię procesorów z sysfs: gniazdo, rdzeń, węzeł NUMA i rodzeństwo SMT
+ * każdego logicznego procesora. Jeśli sysfs jest niedostępny, zwraca idealThreadCount()
+ * procesorów w jednym węźle, bez informacji o SMT.
+ */
+QVector<CpuInfo> detectCpuTopology()
+{
+    QVector<CpuInfo> cpus;
+
+    const QString cpuRoot = "/sys/devices/system/cpu/";
+    const QVector<int> online = parseCpuList(readSysfs(cpuRoot + "online"));
+
+    // Przypisanie procesorów do węzłów NUMA
+    QMap<int, int> nodeOfCpu;
+    QDir nodeDir("/sys/devices/system/node/");
+    for (const QString &entry : nodeDir.entryList(QStringList() << "node*", QDir::Dirs)) {
+        bool ok;
+        int node = entry.mid(4).toInt(&ok);
+        if (!ok) continue;
+
+        for (int cpu : parseCpuList(readSysfs(nodeDir.filePath(entry + "/cpulist")))) {
+            nodeOfCpu[cpu] = node;
+        }
+    }
+
+    for (int cpu : online) {
+        const QString topology = cpuRoot + QString("cpu%1/topology/").arg(cpu);
+
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = readSysfs(topology + "physical_package_id").toInt();
+        info.core = (info.package << 16) | readSysfs(topology + "core_id").toInt();
+        info.node = nodeOfCpu.value(cpu, 0);
+
+        QVector<int> siblings = parseCpuList(readSysfs(topology + "thread_siblings_list"));
+        info.primary = siblings.isEmpty() || *std::min_element(siblings.begin(), siblings.end()) == cpu;
+
+        cpus.append(info);
+    }
+
+    if (cpus.isEmpty()) {
+        for (int cpu = 0; cpu < QThread::idealThreadCount(); cpu++) {
+            CpuInfo info;
+            info.cpu = cpu;
+            info.core = cpu;
+            cpus.append(info);
+        }
+    }
+
+    return cpus;
+}
+
+/**
+ * Odczytuje z sysfs rozmiary pamięci podręcznej danych L1, L2 i L3 procesora 0 oraz liczbę
+ * procesorów współdzielących L3. Poziomy, których nie da się odczytać, mają rozmiar 0.
+ */
+CacheSizes detectCacheSizes()
+{
+    CacheSizes sizes;
+
+    QDir cacheDir("/sys/devices/system/cpu/cpu0/cache/");
+    for (const QString &entry : cacheDir.entryList(QStringList() << "index*", QDir::Dirs)) {
+        const QString index = cacheDir.filePath(entry) + "/";
+        const QString type = readSysfs(index + "type");
+        if (type == "Instruction") continue;
+
+        quint32 size = parseCacheSize(readSysfs(index + "size"));
+        int level = readSysfs(index + "level").toInt();
+        if (level == 1) {
+            sizes.l1d = size;
+        } else if (level == 2) {
+            sizes.l2 = size;
+        } else if (level == 3) {
+            sizes.l3 = size;
+            sizes.l3Sharing = qMax(1, parseCpuList(readSysfs(index + "shared_cpu_list")).size());
+        }
+    }
+
+    return sizes;
+}
+
+/**
+ * Konstruktor klasy WorkerThread.
+ * @param pool Pula, z której wątek pobiera zadania
+ * @param slot Numer wątku w puli
+ * @param cpus Procesory, do których wątek zostanie ograniczony (pusta lista = bez ograniczeń)
+ * @param node Węzeł NUMA preferowany dla alokacji pamięci wątku (-1 = domyślna polityka)
+ */
+WorkerThread::WorkerThread(WorkerPool *pool, int slot, const QVector<int> &cpus, int node) :
+    m_pool(pool),
+    m_slot(slot),
+    m_cpus(cpus),
+    m_node(node)
+{
+}
+
+/**
+ * Główna pętla wątku roboczego: po ustawieniu przypisania do procesora i węzła NUMA
+ * pobiera zadania z kolejki puli aż do jej zamknięcia.
+ */
+void WorkerThread::run()
+{
+    currentWorkerSlot = m_slot;
+    applyPlacement();
+
+    while (QRunnable *task = m_pool->takeTask()) {
+        bool autoDelete = task->autoDelete();
+        task->run();
+        if (autoDelete) delete task;
+
+        m_pool->taskDone();
+    }
+}
+
+/**
+ * Przypina bieżący wątek do jego procesorów i ustawia politykę pamięci MPOL_PREFERRED na węzeł
+ * lokalny. Bufory alokowane przez zadania w run() (segmenty, wyniki) trafiają wtedy do pamięci
+ * węzła, na którym wątek liczy, niezależnie od tego, gdzie działa wątek interfejsu.
+ */
+void WorkerThread::applyPlacement()
+{
+#ifdef Q_OS_LINUX
+    if (!m_cpus.isEmpty()) {
+        setThreadAffinity(pthread_self(), m_cpus);
+    }
+
+    if (m_node >= 0 && m_node < static_cast<int>(sizeof(unsigned long) * 8)) {
+        unsigned long nodeMask = 1UL << m_node;
+        syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodeMask, sizeof(nodeMask) * 8);
+    }
+#endif
+}
+
+/**
+ * Konstruktor klasy WorkerPool - wyznacza rozmieszczenie wątków na podstawie topologii i uruchamia je.
+ * Procesory są przydzielane najpierw po jednym na rdzeń fizyczny (naprzemiennie między węzłami NUMA),
+ * a dopiero potem rodzeństwu SMT, o ile nie wybrano opcji physicalCoresOnly. Przy reserveNetworkCore
+ * pierwszy rdzeń jest wyłączany z puli, a wywołujący wątek (interfejs i gniazdo) jest do niego przypinany
+ * na czas życia puli.
+ * @param options Konfiguracja puli
+ */
+WorkerPool::WorkerPool(const WorkerPoolOptions &options, QObject *parent) :
+    QObject(parent),
+    m_options(options),
+    m_pinnedThread(nullptr),
+    m_running(0),
+    m_quit(false)
+{
+    QVector<CpuInfo> topology = detectCpuTopology();
+
+    // Rezerwacja pierwszego rdzenia dla wątku sieciowego
+    QVector<int> reserved;
+    if (m_options.reserveNetworkCore && topology.size() > 1) {
+        int reservedCore = topology.first().core;
+        QVector<CpuInfo> remaining;
+        for (const CpuInfo &info : topology) {
+            if (info.core == reservedCore) reserved.append(info.cpu);
+            else remaining.append(info);
+        }
+        topology = remaining;
+    }
+
+#ifdef Q_OS_LINUX
+    if (!reserved.isEmpty() && setThreadAffinity(pthread_self(), reserved)) {
+        m_pinnedThread = QThread::currentThreadId();
+    }
+#endif
+
+    // Kolejność przydziału: rdzenie fizyczne przed SMT, naprzemiennie między węzłami
+    QVector<CpuInfo> eligible;
+    for (const CpuInfo &info : topology) {
+        if (!m_options.physicalCoresOnly || info.primary) eligible.append(info);
+    }
+
+    QMap<int, int> rankInNode;
+    QVector<QPair<QPair<int, int>, CpuInfo>> ordered;
+    for (const CpuInfo &info : eligible) {
+        int rank = rankInNode[info.node * 2 + (info.primary ? 0 : 1)]++;
+        ordered.append(qMakePair(qMakePair(info.primary ? 0 : 1, rank), info));
+    }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const QPair<QPair<int, int>, CpuInfo> &a,
+                                                        const QPair<QPair<int, int>, CpuInfo> &b) {
+        if (a.first != b.first) return a.first < b.first;
+        return a.second.node < b.second.node;
+    });
+
+    QVector<int> eligibleCpus;
+    QSet<int> nodes;
+    for (const auto &entry : ordered) {
+        eligibleCpus.append(entry.second.cpu);
+        nodes.insert(entry.second.node);
+    }
+
+    int threadCount = m_options.threads > 0 ? m_options.threads : ordered.size();
+    if (threadCount <= 0) threadCount = QThread::idealThreadCount();
+
+    QVector<int> assigned;
+    for (int i = 0; i < threadCount; i++) {
+        QVector<int> cpus;
+        int node = -1;
+
+        if (!ordered.isEmpty() && m_options.pinThreads) {
+            const CpuInfo &info = ordered[i % ordered.size()].second;
+            cpus.append(info.cpu);
+            node = info.node;
+            assigned.append(info.cpu);
+        } else if (!reserved.isEmpty()) {
+            cpus = eligibleCpus;
+        }
+
+        WorkerThread *worker = new WorkerThread(this, i, cpus, node);
+        m_workers.append(worker);
+        worker->start();
+    }
+
+    m_description = QString("%1 threads").arg(threadCount);
+    if (m_options.pinThreads && !assigned.isEmpty()) {
+        m_description += QString(" pinned to CPUs %1").arg(formatCpuList(assigned));
+    }
+    m_description += QString(" across %1 NUMA node(s)").arg(qMax(1, nodes.size()));
+    if (!reserved.isEmpty()) {
+        m_description += QString(", CPUs %1 reserved for networking").arg(formatCpuList(reserved));
+    }
+}
+
+/**
+ * Destruktor klasy WorkerPool - zamyka kolejkę, czeka na zakończenie bieżących zadań
+ * i usuwa zadania, które nie zostały rozpoczęte. Wątek przypięty przez konstruktor
+ * do zarezerwowanego rdzenia odzyskuje wszystkie procesory.
+ */
+WorkerPool::~WorkerPool()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_quit = true;
+
+        while (!m_queue.isEmpty()) {
+            QRunnable *task = m_queue.dequeue();
+            if (task->autoDelete()) delete task;
+        }
+        m_taskAvailable.wakeAll();
+    }
+
+    for (WorkerThread *worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+
+#ifdef Q_OS_LINUX
+    // Na Linuksie identyfikator wątku Qt jest wartością pthread_t
+    if (m_pinnedThread) {
+        setThreadAffinity(reinterpret_cast<pthread_t>(m_pinnedThread), QVector<int>());
+    }
+#endif
+}
+
+/**
+ * Dodaje zadanie do kolejki puli. Przy włączonym autoDelete pula usuwa zadanie po wykonaniu.
+ */
+void WorkerPool::start(QRunnable *task)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.enqueue(task);
+    m_taskAvailable.wakeOne();
+}
+
+/**
+ * Usuwa z kolejki zadania, które nie zostały jeszcze rozpoczęte (zadania z autoDelete są niszczone).
+ * Zadania wykonywane w tej chwili kończą się normalnie.
+ * @return Liczba usuniętych zadań
+ */
+int WorkerPool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    int removed = m_queue.size();
+    while (!m_queue.isEmpty()) {
+        QRunnable *task = m_queue.dequeue();
+        if (task->autoDelete()) delete task;
+    }
+    if (m_running == 0) m_allDone.wakeAll();
+    return removed;
+}
+
+/**
+ * Czeka, aż kolejka będzie pusta i wszystkie zadania się zakończą.
+ * @param msecs Limit czasu w milisekundach (-1 = bez limitu)
+ * @return true jeśli pula jest bezczynna
+ */
+bool WorkerPool::waitForDone(int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!m_queue.isEmpty() || m_running > 0) {
+        unsigned long remaining = ULONG_MAX;
+        if (msecs >= 0) {
+            qint64 left = msecs - timer.elapsed();
+            if (left <= 0) return false;
+            remaining = static_cast<unsigned long>(left);
+        }
+        m_allDone.wait(&m_mutex, remaining);
+    }
+    return true;
+}
+
+/**
+ * Zwraca numer bieżącego wątku w jego puli (0..maxThreadCount-1). Numery powtarzają się
+ * w kolejnych pulach, dlatego nadają się na etykiety metryk o ograniczonej liczbie serii.
+ * Poza wątkami puli zwraca 0.
+ */
+int WorkerPool::currentSlot()
+{
+    return currentWorkerSlot;
+}
+
+int WorkerPool::maxThreadCount() const
+{
+    return m_workers.size();
+}
+
+/**
+ * Zwraca liczbę zadań wykonywanych obecnie przez wątki puli.
+ */
+int WorkerPool::activeThreadCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_running;
+}
+
+/**
+ * Zwraca true, jeśli żadne zadanie nie jest wykonywane ani nie czeka w kolejce.
+ */
+bool WorkerPool::isIdle() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.isEmpty() && m_running == 0;
+}
+
+/**
+ * Pobiera zadanie z kolejki, blokując wątek do czasu jego pojawienia się.
+ * @return Zadanie do wykonania lub nullptr, gdy pula jest zamykana
+ */
+QRunnable *WorkerPool::takeTask()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_queue.isEmpty() && !m_quit) {
+        m_taskAvailable.wait(&m_mutex);
+    }
+    if (m_quit) return nullptr;
+
+    m_running++;
+    return m_queue.dequeue();
+}
+
+/**
+ * Oznacza zakończenie zadania i budzi oczekujących w waitForDone().
+ */
+void WorkerPool::taskDone()
+{
+    QMutexLocker locker(&m_mutex);
+    m_running--;
+
+    if (m_running == 0 && m_queue.isEmpty()) {
+        m_allDone.wakeAll();
+    }
+}
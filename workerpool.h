@@ -0,0 +1,108 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QObject>
+#include <QThread>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QList>
+#include <QString>
+
+struct CpuInfo
+{
+    int cpu = 0;            // numer logicznego procesora
+    int package = 0;        // gniazdo (socket)
+    int core = 0;           // identyfikator rdzenia unikalny w obrębie całej maszyny
+    int node = 0;           // węzeł NUMA
+    bool primary = true;    // pierwszy wątek SMT rdzenia
+};
+
+QVector<CpuInfo> detectCpuTopology();
+
+struct CacheSizes
+{
+    quint32 l1d = 0;        // rozmiary w bajtach, 0 = nieznany
+    quint32 l2 = 0;
+    quint32 l3 = 0;
+    int l3Sharing = 1;      // liczba procesorów logicznych współdzielących L3
+};
+
+CacheSizes detectCacheSizes();
+
+struct WorkerPoolOptions
+{
+    int threads = 0;                    // 0 = po jednym wątku na każdy dostępny procesor
+    bool pinThreads = true;             // przypięcie każdego wątku do jednego procesora
+    bool physicalCoresOnly = false;     // pomijanie rodzeństwa SMT (hyper-threading)
+    bool reserveNetworkCore = false;    // pierwszy rdzeń tylko dla wątku sieci/interfejsu
+
+    bool operator==(const WorkerPoolOptions &other) const
+    {
+        return threads == other.threads && pinThreads == other.pinThreads
+               && physicalCoresOnly == other.physicalCoresOnly
+               && reserveNetworkCore == other.reserveNetworkCore;
+    }
+    bool operator!=(const WorkerPoolOptions &other) const { return !(*this == other); }
+};
+
+class WorkerPool;
+
+class WorkerThread : public QThread
+{
+public:
+    WorkerThread(WorkerPool *pool, int slot, const QVector<int> &cpus, int node);
+
+protected:
+    void run() override;
+
+private:
+    void applyPlacement();
+
+    WorkerPool *m_pool;
+    int m_slot;             // numer wątku w puli (0..maxThreadCount-1)
+    QVector<int> m_cpus;    // dozwolone procesory (pusty = bez ograniczeń)
+    int m_node;             // preferowany węzeł NUMA dla alokacji (-1 = domyślna polityka)
+};
+
+class WorkerPool : public QObject
+{
+public:
+    explicit WorkerPool(const WorkerPoolOptions &options, QObject *parent = nullptr);
+    ~WorkerPool();
+
+    void start(QRunnable *task);
+    int clear();
+    bool waitForDone(int msecs = -1);
+
+    static int currentSlot();
+
+    int maxThreadCount() const;
+    int activeThreadCount() const;
+    bool isIdle() const;
+
+    WorkerPoolOptions options() const { return m_options; }
+    QString placementDescription() const { return m_description; }
+
+private:
+    friend class WorkerThread;
+
+    QRunnable *takeTask();
+    void taskDone();
+
+    WorkerPoolOptions m_options;
+    QString m_description;
+    QList<WorkerThread*> m_workers;
+    Qt::HANDLE m_pinnedThread;      // wątek przypięty do zarezerwowanego rdzenia (nullptr = brak)
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_taskAvailable;
+    QWaitCondition m_allDone;
+    QQueue<QRunnable*> m_queue;
+    int m_running;
+    bool m_quit;
+};
+
+#endif // WORKERPOOL_H